@@ -35,6 +35,7 @@ parser.addParameter('addOutputToPath', true, @islogical);
 parser.addParameter('includePaths', '-I/usr/local/include', @ischar);
 parser.addParameter('libPaths', '-L/usr/local/lib', @ischar);
 parser.addParameter('libs', '-lassimp', @ischar);
+parser.addParameter('threadFlags', 'CXXFLAGS="$CXXFLAGS -std=c++11 -pthread" LDFLAGS="$LDFLAGS -pthread"', @ischar);
 parser.parse(varargin{:});
 outputFolder = parser.Results.outputFolder;
 clean = parser.Results.clean;
@@ -42,6 +43,7 @@ addOutputToPath = parser.Results.addOutputToPath;
 includePaths = parser.Results.includePaths;
 libPaths = parser.Results.libPaths;
 libs = parser.Results.libs;
+threadFlags = parser.Results.threadFlags;
 
 
 %% Set up build folder.
@@ -63,33 +65,60 @@ end
 source = which('mexximp_constants.cc');
 output = sprintf('-output %s', fullfile(outputFolder, 'mexximpConstants'));
 
-mexCmd = sprintf('mex -v %s %s %s %s %s', includePaths, libPaths, libs, output, source);
+mexCmd = sprintf('mex -v %s %s %s %s %s %s', threadFlags, includePaths, libPaths, libs, output, source);
+fprintf('%s\n', mexCmd);
+eval(mexCmd);
+
+
+%% Build a utility for walking scene node hierarchies.
+source = [which('mexximp_nodes.cc') ' ' which('mexximp_kernels.cc')];
+output = sprintf('-output %s', fullfile(outputFolder, 'mexximpNodes'));
+
+mexCmd = sprintf('mex %s %s %s %s %s %s', threadFlags, includePaths, libPaths, libs, output, source);
+fprintf('%s\n', mexCmd);
+eval(mexCmd);
+
+
+%% Build a utility for combining scenes.
+source = which('mexximp_combine.cc');
+output = sprintf('-output %s', fullfile(outputFolder, 'mexximpCombine'));
+
+mexCmd = sprintf('mex %s %s %s %s %s %s', threadFlags, includePaths, libPaths, libs, output, source);
+fprintf('%s\n', mexCmd);
+eval(mexCmd);
+
+
+%% Build a utility for writing binary PLY meshes.
+source = [which('mexximp_ply.cc') ' ' which('mexximp_kernels.cc')];
+output = sprintf('-output %s', fullfile(outputFolder, 'mexximpWritePly'));
+
+mexCmd = sprintf('mex %s %s %s %s %s %s', threadFlags, includePaths, libPaths, libs, output, source);
 fprintf('%s\n', mexCmd);
 eval(mexCmd);
 
 
 %% Build a utility for testing mexximp internals.
-source = [which('mexximp_test.cc') ' ' which('mexximp_util.cc') ' ' which('mexximp_scene.cc')];
+source = [which('mexximp_test.cc') ' ' which('mexximp_util.cc') ' ' which('mexximp_scene.cc') ' ' which('mexximp_kernels.cc') ' ' which('mexximp_threads.cc') ' ' which('mexximp_arena.cc') ' ' which('mexximp_timing.cc')];
 output = sprintf('-output %s', fullfile(outputFolder, 'mexximpTest'));
 
-mexCmd = sprintf('mex %s %s %s %s %s', includePaths, libPaths, libs, output, source);
+mexCmd = sprintf('mex %s %s %s %s %s %s', threadFlags, includePaths, libPaths, libs, output, source);
 fprintf('%s\n', mexCmd);
 eval(mexCmd);
 
 
 %% Build the importer.
-source = [which('mexximp_import.cc') ' ' which('mexximp_util.cc') ' ' which('mexximp_scene.cc')];
+source = [which('mexximp_import.cc') ' ' which('mexximp_util.cc') ' ' which('mexximp_scene.cc') ' ' which('mexximp_kernels.cc') ' ' which('mexximp_threads.cc') ' ' which('mexximp_arena.cc') ' ' which('mexximp_cache.cc') ' ' which('mexximp_jobs.cc') ' ' which('mexximp_io.cc') ' ' which('mexximp_timing.cc')];
 output = sprintf('-output %s', fullfile(outputFolder, 'mexximpImport'));
 
-mexCmd = sprintf('mex %s %s %s %s %s', includePaths, libPaths, libs, output, source);
+mexCmd = sprintf('mex %s %s %s %s %s %s', threadFlags, includePaths, libPaths, libs, output, source);
 fprintf('%s\n', mexCmd);
 eval(mexCmd);
 
 
 %% Build the exporter.
-source = [which('mexximp_export.cc') ' ' which('mexximp_util.cc') ' ' which('mexximp_scene.cc')];
+source = [which('mexximp_export.cc') ' ' which('mexximp_util.cc') ' ' which('mexximp_scene.cc') ' ' which('mexximp_kernels.cc') ' ' which('mexximp_threads.cc') ' ' which('mexximp_arena.cc') ' ' which('mexximp_io.cc') ' ' which('mexximp_timing.cc')];
 output = sprintf('-output %s', fullfile(outputFolder, 'mexximpExport'));
 
-mexCmd = sprintf('mex %s %s %s %s %s', includePaths, libPaths, libs, output, source);
+mexCmd = sprintf('mex %s %s %s %s %s %s', threadFlags, includePaths, libPaths, libs, output, source);
 fprintf('%s\n', mexCmd);
 eval(mexCmd);
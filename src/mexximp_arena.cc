@@ -0,0 +1,82 @@
+// Bump allocation for the many small arrays of an exported aiScene.
+
+#include "mexximp_arena.h"
+
+#include <stdlib.h>
+
+namespace mexximp {
+    
+    static const size_t arena_alignment = 16;
+    
+    void* arena::allocate(size_t num_bytes) {
+        size_t padded = (num_bytes + arena_alignment - 1) & ~(arena_alignment - 1);
+        if (0 == padded) {
+            padded = arena_alignment;
+        }
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        
+        // big requests get their own block, so the current block keeps its space
+        if (padded > block_size / 4) {
+            char* block = (char*)malloc(padded);
+            if (!block) {
+                throw std::bad_alloc();
+            }
+            blocks.push_back(block);
+            total_bytes += padded;
+            return block;
+        }
+        
+        if (padded > remaining) {
+            char* block = (char*)malloc(block_size);
+            if (!block) {
+                throw std::bad_alloc();
+            }
+            blocks.push_back(block);
+            total_bytes += block_size;
+            next = block;
+            remaining = block_size;
+        }
+        
+        void* bytes = next;
+        next += padded;
+        remaining -= padded;
+        return bytes;
+    }
+    
+    void arena::release() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < blocks.size(); i++) {
+            free(blocks[i]);
+        }
+        blocks.clear();
+        next = 0;
+        remaining = 0;
+        total_bytes = 0;
+    }
+    
+    void detach_arena_allocations(aiScene* assimp_scene) {
+        if (!assimp_scene) {
+            return;
+        }
+        
+        // faces and their indices, so ~aiMesh skips the per-face deletes
+        for (unsigned i = 0; assimp_scene->mMeshes && i < assimp_scene->mNumMeshes; i++) {
+            aiMesh* mesh = assimp_scene->mMeshes[i];
+            if (mesh) {
+                mesh->mFaces = 0;
+                mesh->mNumFaces = 0;
+            }
+        }
+        
+        // properties and their data, so ~aiMaterial skips the per-property deletes
+        for (unsigned i = 0; assimp_scene->mMaterials && i < assimp_scene->mNumMaterials; i++) {
+            aiMaterial* material = assimp_scene->mMaterials[i];
+            if (material) {
+                material->mProperties = 0;
+                material->mNumProperties = 0;
+                material->mNumAllocated = 0;
+            }
+        }
+    }
+}
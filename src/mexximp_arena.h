@@ -0,0 +1,61 @@
+/** Bump allocation for the many small arrays of an exported aiScene.
+ *
+ *  Face indices and material properties come from a few large blocks
+ *  instead of one new[] each.  Assimp would delete them one at a time,
+ *  so detach_arena_allocations() forgets them first, then the whole arena
+ *  is released at once.
+ */
+
+#ifndef MEXXIMP_ARENA_H_
+#define MEXXIMP_ARENA_H_
+
+#include <stddef.h>
+#include <mutex>
+#include <new>
+#include <vector>
+#include <assimp/scene.h>
+
+namespace mexximp {
+    
+    struct arena {
+        std::vector<char*> blocks;
+        char* next;
+        size_t remaining;
+        size_t block_size;
+        size_t total_bytes;
+        std::mutex mutex;
+        
+        arena(size_t block_bytes = 4 * 1024 * 1024) : next(0), remaining(0), block_size(block_bytes), total_bytes(0) {}
+        ~arena() {
+            release();
+        }
+        
+        // 16-byte aligned bytes that live until release(), safe to call from worker threads
+        void* allocate(size_t num_bytes);
+        
+        // default-constructed elements, which are never destroyed
+        template <typename T>
+        T* allocate_array(size_t count) {
+            if (0 == count) {
+                return 0;
+            }
+            T* elements = (T*)allocate(count * sizeof(T));
+            for (size_t i = 0; i < count; i++) {
+                new (&elements[i]) T();
+            }
+            return elements;
+        }
+        
+        // free all blocks at once
+        void release();
+    
+    private:
+        arena(const arena&);
+        arena& operator=(const arena&);
+    };
+    
+    // forget face and material property arrays that came from an arena, before the aiScene destructor runs
+    void detach_arena_allocations(aiScene* assimp_scene);
+}
+
+#endif  // MEXXIMP_ARENA_H_
@@ -0,0 +1,287 @@
+// In-process cache of imported Matlab scenes.
+
+#include "mexximp_cache.h"
+#include "mexximp_constants.h"
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <list>
+#include <map>
+#include <sstream>
+#include <mex.h>
+
+#ifdef _WIN32
+#define stat _stat64
+#endif
+
+namespace mexximp {
+    
+    // sub-second parts of file times, where the platform has them
+#if defined(__APPLE__)
+    static long long modified_nanoseconds(const struct stat& file_stat) {
+        return file_stat.st_mtimespec.tv_nsec;
+    }
+    
+    static long long changed_nanoseconds(const struct stat& file_stat) {
+        return (long long)file_stat.st_ctimespec.tv_sec * 1000000000LL + file_stat.st_ctimespec.tv_nsec;
+    }
+#elif defined(_WIN32)
+    static long long modified_nanoseconds(const struct stat& /* file_stat */) {
+        return 0;
+    }
+    
+    static long long changed_nanoseconds(const struct stat& file_stat) {
+        return (long long)file_stat.st_ctime * 1000000000LL;
+    }
+#else
+    static long long modified_nanoseconds(const struct stat& file_stat) {
+        return file_stat.st_mtim.tv_nsec;
+    }
+    
+    static long long changed_nanoseconds(const struct stat& file_stat) {
+        return (long long)file_stat.st_ctim.tv_sec * 1000000000LL + file_stat.st_ctim.tv_nsec;
+    }
+#endif
+    
+    bool cache_key::operator<(const cache_key& other) const {
+        if (path != other.path) {
+            return path < other.path;
+        }
+        if (file_bytes != other.file_bytes) {
+            return file_bytes < other.file_bytes;
+        }
+        if (modified != other.modified) {
+            return modified < other.modified;
+        }
+        if (modified_nanoseconds != other.modified_nanoseconds) {
+            return modified_nanoseconds < other.modified_nanoseconds;
+        }
+        if (changed != other.changed) {
+            return changed < other.changed;
+        }
+        if (inode != other.inode) {
+            return inode < other.inode;
+        }
+        if (postprocess_flags != other.postprocess_flags) {
+            return postprocess_flags < other.postprocess_flags;
+        }
+        if (packed_faces != other.packed_faces) {
+            return packed_faces < other.packed_faces;
+        }
+        if (single_precision != other.single_precision) {
+            return single_precision < other.single_precision;
+        }
+        if (mesh_fields != other.mesh_fields) {
+            return mesh_fields < other.mesh_fields;
+        }
+        if (flat_nodes != other.flat_nodes) {
+            return flat_nodes < other.flat_nodes;
+        }
+        if (mesh_bounds != other.mesh_bounds) {
+            return mesh_bounds < other.mesh_bounds;
+        }
+        return config < other.config;
+    }
+    
+    // config properties change what gets imported, so they're part of the key
+    static std::string config_key_string(const std::vector<config_property>& config) {
+        std::ostringstream stream;
+        stream.precision(9);
+        for (size_t i = 0; i < config.size(); i++) {
+            const config_property& property = config[i];
+            stream << property.name << ':' << property.type << '=';
+            switch (property.type) {
+                case config_integer:
+                    stream << property.integer_value;
+                    break;
+                case config_float:
+                    stream << property.float_value;
+                    break;
+                case config_string:
+                    stream << property.string_value.size() << ':' << property.string_value;
+                    break;
+                default:
+                    for (unsigned e = 0; e < 16; e++) {
+                        stream << ((const float*)&property.matrix_value)[e] << ',';
+                    }
+                    break;
+            }
+            stream << ';';
+        }
+        return stream.str();
+    }
+    
+    static std::string absolute_path(const std::string& file) {
+#ifdef _WIN32
+        char* resolved = _fullpath(0, file.c_str(), 0);
+#else
+        char* resolved = realpath(file.c_str(), 0);
+#endif
+        if (!resolved) {
+            return file;
+        }
+        std::string path(resolved);
+        free(resolved);
+        return path;
+    }
+    
+    bool make_cache_key(const std::string& file, unsigned postprocess_flags, const import_options& options, cache_key* key) {
+        if (!key) {
+            return false;
+        }
+        
+        key->path = absolute_path(file);
+        
+        struct stat file_stat;
+        if (0 != stat(key->path.c_str(), &file_stat)) {
+            return false;
+        }
+        
+        key->file_bytes = file_stat.st_size;
+        
+        // a file rewritten within the same second at the same size still gets a new key
+        key->modified = file_stat.st_mtime;
+        key->modified_nanoseconds = modified_nanoseconds(file_stat);
+        key->changed = changed_nanoseconds(file_stat);
+        key->inode = file_stat.st_ino;
+        
+        key->postprocess_flags = postprocess_flags;
+        key->packed_faces = options.packed_faces;
+        key->single_precision = options.single_precision;
+        key->mesh_fields = options.mesh_fields | mesh_required_fields;
+        key->flat_nodes = options.flat_nodes;
+        key->mesh_bounds = options.mesh_bounds;
+        key->config = config_key_string(options.config);
+        return true;
+    }
+    
+    // least recently used entries at the back of the list
+    
+    struct cache_entry {
+        cache_key key;
+        mxArray* scene;
+        size_t scene_bytes;
+        unsigned hits;
+    };
+    
+    typedef std::list<cache_entry> cache_list;
+    
+    static cache_list cache_entries;
+    static std::map<cache_key, cache_list::iterator> cache_index;
+    static size_t total_bytes = 0;
+    static size_t budget = 512 * 1024 * 1024;
+    static bool is_locked = false;
+    
+    static void evict_oldest() {
+        cache_entry& oldest = cache_entries.back();
+        mxDestroyArray(oldest.scene);
+        total_bytes -= oldest.scene_bytes;
+        cache_index.erase(oldest.key);
+        cache_entries.pop_back();
+    }
+    
+    static void fit_budget() {
+        while (!cache_entries.empty() && total_bytes > budget) {
+            evict_oldest();
+        }
+        
+        if (cache_entries.empty() && is_locked) {
+            mexUnlock();
+            is_locked = false;
+        }
+    }
+    
+    const mxArray* cache_find(const cache_key& key) {
+        std::map<cache_key, cache_list::iterator>::iterator found = cache_index.find(key);
+        if (found == cache_index.end()) {
+            return 0;
+        }
+        
+        cache_entries.splice(cache_entries.begin(), cache_entries, found->second);
+        found->second->hits++;
+        return found->second->scene;
+    }
+    
+    void cache_insert(const cache_key& key, const mxArray* scene) {
+        if (!scene) {
+            return;
+        }
+        
+        size_t scene_bytes = array_bytes(scene);
+        if (scene_bytes > budget || cache_index.count(key)) {
+            return;
+        }
+        
+        cache_entry entry;
+        entry.key = key;
+        entry.scene = mxDuplicateArray(scene);
+        entry.scene_bytes = scene_bytes;
+        entry.hits = 0;
+        if (!entry.scene) {
+            return;
+        }
+        mexMakeArrayPersistent(entry.scene);
+        
+        cache_entries.push_front(entry);
+        cache_index[key] = cache_entries.begin();
+        total_bytes += scene_bytes;
+        
+        if (!is_locked) {
+            mexLock();
+            is_locked = true;
+        }
+        
+        fit_budget();
+    }
+    
+    void cache_clear() {
+        while (!cache_entries.empty()) {
+            evict_oldest();
+        }
+        fit_budget();
+    }
+    
+    void cache_set_budget(size_t budget_bytes) {
+        budget = budget_bytes;
+        fit_budget();
+    }
+    
+    static const char* cache_info_field_names[] = {
+        "budgetBytes",
+        "totalBytes",
+        "entries",
+    };
+    
+    static const char* cache_entry_field_names[] = {
+        "file",
+        "fileBytes",
+        "modified",
+        "postprocessFlags",
+        "packedFaces",
+        "singlePrecision",
+        "sceneBytes",
+        "hits",
+    };
+    
+    mxArray* cache_info() {
+        mxArray* info = mxCreateStructMatrix(1, 1, COUNT(cache_info_field_names), cache_info_field_names);
+        mxSetField(info, 0, "budgetBytes", mxCreateDoubleScalar(budget));
+        mxSetField(info, 0, "totalBytes", mxCreateDoubleScalar(total_bytes));
+        
+        mxArray* matlab_entries = mxCreateStructMatrix(1, cache_entries.size(), COUNT(cache_entry_field_names), cache_entry_field_names);
+        unsigned i = 0;
+        for (cache_list::const_iterator entry = cache_entries.begin(); entry != cache_entries.end(); ++entry, i++) {
+            mxSetField(matlab_entries, i, "file", mxCreateString(entry->key.path.c_str()));
+            mxSetField(matlab_entries, i, "fileBytes", mxCreateDoubleScalar(entry->key.file_bytes));
+            mxSetField(matlab_entries, i, "modified", mxCreateDoubleScalar(entry->key.modified));
+            mxSetField(matlab_entries, i, "postprocessFlags", mxCreateDoubleScalar(entry->key.postprocess_flags));
+            mxSetField(matlab_entries, i, "packedFaces", mxCreateLogicalScalar(entry->key.packed_faces));
+            mxSetField(matlab_entries, i, "singlePrecision", mxCreateLogicalScalar(entry->key.single_precision));
+            mxSetField(matlab_entries, i, "sceneBytes", mxCreateDoubleScalar(entry->scene_bytes));
+            mxSetField(matlab_entries, i, "hits", mxCreateDoubleScalar(entry->hits));
+        }
+        mxSetField(info, 0, "entries", matlab_entries);
+        
+        return info;
+    }
+}
@@ -0,0 +1,59 @@
+/** In-process cache of imported Matlab scenes.
+ *
+ *  Cached scenes are persistent Matlab arrays, so the mex-function that
+ *  owns the cache stays locked with mexLock while the cache is not empty,
+ *  and should call cache_clear from its mexAtExit function.
+ *  Scenes are keyed by absolute file path, file size and modification
+ *  time, postprocess flags, and any import options that change the scene
+ *  layout.  The least recently used scenes are evicted first, to keep the
+ *  total size under a memory budget.
+ *
+ *  These functions use the mx API, so only call them on the Matlab thread.
+ */
+
+#ifndef MEXXIMP_CACHE_H_
+#define MEXXIMP_CACHE_H_
+
+#include <stddef.h>
+#include <string>
+#include <matrix.h>
+#include "mexximp_scene.h"
+
+namespace mexximp {
+    
+    struct cache_key {
+        std::string path;
+        long long file_bytes;
+        long long modified;
+        long long modified_nanoseconds;
+        long long changed;
+        long long inode;
+        unsigned postprocess_flags;
+        bool packed_faces;
+        bool single_precision;
+        unsigned mesh_fields;
+        bool flat_nodes;
+        bool mesh_bounds;
+        std::string config;
+        
+        bool operator<(const cache_key& other) const;
+    };
+    
+    // false if the file can't be found
+    bool make_cache_key(const std::string& file, unsigned postprocess_flags, const import_options& options, cache_key* key);
+    
+    // cached scene owned by the cache, or 0 -- callers should duplicate it
+    const mxArray* cache_find(const cache_key& key);
+    
+    // cache a duplicate of the given scene, evicting older scenes to fit the budget
+    void cache_insert(const cache_key& key, const mxArray* scene);
+    
+    void cache_clear();
+    
+    void cache_set_budget(size_t budget_bytes);
+    
+    // struct describing the budget and each cached scene, most recently used first
+    mxArray* cache_info();
+}
+
+#endif  // MEXXIMP_CACHE_H_
@@ -0,0 +1,406 @@
+// Combine several Matlab scenes in one pass, for utilities like mexximpCombineScenes.
+
+#include <mex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "mexximp_constants.h"
+#include "mexximp_util.h"
+
+void printUsage() {
+    mexPrintf("Combine scenes by appending materials, meshes, textures, and nodes:\n");
+    mexPrintf("  combined = mexximpCombine(outer, inners, importTransforms, insertPrefixes)\n");
+    mexPrintf("inners is a struct array or cell array of scenes with nested nodes.\n");
+    mexPrintf("importTransforms(:,:,k) premultiplies top-level nodes of inner scene k, [] for identity.\n");
+    mexPrintf("insertPrefixes{k} prefixes mesh and top-level node names of inner scene k, or one string for all.\n");
+    mexPrintf("Material, mesh, and embedded texture \"*N\" indices are offset to match the combined scene.\n");
+    mexPrintf("\n");
+}
+
+// one scene being combined, and where its elements land
+struct scene_part {
+    const mxArray* scene;
+    unsigned index;
+    const double* import_transform;
+    std::string prefix;
+    unsigned material_offset;
+    unsigned mesh_offset;
+    unsigned texture_offset;
+};
+
+static const mxArray* scene_field(const scene_part& part, const char* field_name) {
+    const mxArray* value = mxGetField(part.scene, part.index, field_name);
+    return value && mxIsStruct(value) ? value : 0;
+}
+
+static unsigned num_structs(const mxArray* matlab_structs) {
+    return matlab_structs && mxIsStruct(matlab_structs) ? mxGetNumberOfElements(matlab_structs) : 0;
+}
+
+// fields of all the given struct arrays, in order of first appearance
+static void union_field_names(const std::vector<const mxArray*>& sources, std::vector<const char*>* field_names) {
+    for (unsigned s = 0; s < sources.size(); s++) {
+        if (!sources[s] || !mxIsStruct(sources[s])) {
+            continue;
+        }
+        unsigned num_fields = mxGetNumberOfFields(sources[s]);
+        for (unsigned f = 0; f < num_fields; f++) {
+            const char* field_name = mxGetFieldNameByNumber(sources[s], f);
+            bool is_new = true;
+            for (unsigned n = 0; n < field_names->size() && is_new; n++) {
+                is_new = 0 != strcmp((*field_names)[n], field_name);
+            }
+            if (is_new) {
+                field_names->push_back(field_name);
+            }
+        }
+    }
+}
+
+// one row with elements of all the given struct arrays, each element copied once
+static mxArray* concatenate_structs(const std::vector<const mxArray*>& sources, std::vector<unsigned>* starts) {
+    std::vector<const char*> field_names;
+    union_field_names(sources, &field_names);
+    
+    unsigned num_elements = 0;
+    starts->assign(sources.size(), 0);
+    for (unsigned s = 0; s < sources.size(); s++) {
+        (*starts)[s] = num_elements;
+        num_elements += num_structs(sources[s]);
+    }
+    
+    if (field_names.empty()) {
+        return sources[0] ? mxDuplicateArray(sources[0]) : mexximp::emptyDouble();
+    }
+    
+    mxArray* combined = mxCreateStructMatrix(1, num_elements, field_names.size(), field_names.data());
+    for (unsigned s = 0; s < sources.size(); s++) {
+        unsigned num_source = num_structs(sources[s]);
+        for (unsigned f = 0; f < field_names.size(); f++) {
+            int source_field = mexximp::field_number(sources[s], field_names[f]);
+            if (0 > source_field) {
+                continue;
+            }
+            for (unsigned i = 0; i < num_source; i++) {
+                const mxArray* value = mxGetFieldByNumber(sources[s], i, source_field);
+                if (value) {
+                    mxSetFieldByNumber(combined, (*starts)[s] + i, f, mxDuplicateArray(value));
+                }
+            }
+        }
+    }
+    return combined;
+}
+
+// copy of a scalar struct, except the fields that get combined
+static mxArray* copy_struct_except(const mxArray* source, unsigned index, const char* skip_names[], unsigned num_skip) {
+    unsigned num_fields = mxGetNumberOfFields(source);
+    std::vector<const char*> field_names(num_fields);
+    for (unsigned f = 0; f < num_fields; f++) {
+        field_names[f] = mxGetFieldNameByNumber(source, f);
+    }
+    
+    mxArray* copy = mxCreateStructMatrix(1, 1, num_fields, field_names.data());
+    for (unsigned f = 0; f < num_fields; f++) {
+        if (0 <= mexximp::string_index(skip_names, num_skip, field_names[f])) {
+            continue;
+        }
+        const mxArray* value = mxGetFieldByNumber(source, index, f);
+        if (value) {
+            mxSetFieldByNumber(copy, 0, f, mxDuplicateArray(value));
+        }
+    }
+    return copy;
+}
+
+// in-place edits of copied elements
+
+template <typename T>
+static void offset_data(T* data, size_t num_elements, unsigned offset) {
+    for (size_t i = 0; i < num_elements; i++) {
+        data[i] += offset;
+    }
+}
+
+static void offset_indices(mxArray* matlab_indices, unsigned offset) {
+    if (!matlab_indices || 0 == offset) {
+        return;
+    }
+    
+    void* data = mxGetData(matlab_indices);
+    size_t num_elements = mxGetNumberOfElements(matlab_indices);
+    switch (mxGetClassID(matlab_indices)) {
+        case mxUINT32_CLASS:
+            offset_data((uint32_T*)data, num_elements, offset);
+            break;
+        case mxINT32_CLASS:
+            offset_data((int32_T*)data, num_elements, offset);
+            break;
+        case mxDOUBLE_CLASS:
+            offset_data((double*)data, num_elements, offset);
+            break;
+        case mxSINGLE_CLASS:
+            offset_data((float*)data, num_elements, offset);
+            break;
+        default:
+            break;
+    }
+}
+
+static void replace_field(mxArray* matlab_struct, unsigned index, int field_number, mxArray* value) {
+    mxDestroyArray(mxGetFieldByNumber(matlab_struct, index, field_number));
+    mxSetFieldByNumber(matlab_struct, index, field_number, value);
+}
+
+static std::string string_value(const mxArray* matlab_string) {
+    if (!matlab_string || !mxIsChar(matlab_string)) {
+        return std::string();
+    }
+    char* value = mxArrayToString(matlab_string);
+    std::string string(value ? value : "");
+    mxFree(value);
+    return string;
+}
+
+static void prefix_name(mxArray* matlab_struct, unsigned index, int name_field, const std::string& prefix) {
+    if (prefix.empty() || 0 > name_field) {
+        return;
+    }
+    
+    std::string name = prefix + string_value(mxGetFieldByNumber(matlab_struct, index, name_field));
+    replace_field(matlab_struct, index, name_field, mxCreateString(name.c_str()));
+}
+
+// c = a * b, for column-major 4x4 matrices
+static inline void multiply_4x4(const double* a, const double* b, double* c) {
+    for (unsigned col = 0; col < 4; col++) {
+        for (unsigned row = 0; row < 4; row++) {
+            c[row + 4 * col] = a[row] * b[4 * col]
+                    + a[row + 4] * b[1 + 4 * col]
+                    + a[row + 8] * b[2 + 4 * col]
+                    + a[row + 12] * b[3 + 4 * col];
+        }
+    }
+}
+
+static void premultiply_transformation(mxArray* nodes, unsigned index, int transformation_field, const double* import_transform) {
+    if (!import_transform || 0 > transformation_field) {
+        return;
+    }
+    
+    mxArray* transformation = mxGetFieldByNumber(nodes, index, transformation_field);
+    mxArray* combined = mxCreateDoubleMatrix(4, 4, mxREAL);
+    if (transformation && mxIsDouble(transformation) && 16 == mxGetNumberOfElements(transformation)) {
+        multiply_4x4(import_transform, mxGetPr(transformation), mxGetPr(combined));
+    } else {
+        memcpy(mxGetPr(combined), import_transform, 16 * sizeof(double));
+    }
+    replace_field(nodes, index, transformation_field, combined);
+}
+
+// meshIndices of a copied subtree, without recursion
+static void offset_subtree_meshes(mxArray* nodes, unsigned index, unsigned mesh_offset) {
+    if (0 == mesh_offset) {
+        return;
+    }
+    
+    std::vector<std::pair<mxArray*, unsigned> > stack(1, std::make_pair(nodes, index));
+    while (!stack.empty()) {
+        mxArray* array = stack.back().first;
+        unsigned i = stack.back().second;
+        stack.pop_back();
+        
+        offset_indices(mxGetField(array, i, "meshIndices"), mesh_offset);
+        
+        mxArray* children = mxGetField(array, i, "children");
+        unsigned num_children = num_structs(children);
+        for (unsigned c = 0; c < num_children; c++) {
+            stack.push_back(std::make_pair(children, c));
+        }
+    }
+}
+
+// embedded texture references look like "*0", "*1", etc.
+static void offset_texture_references(mxArray* materials, unsigned index, unsigned texture_offset) {
+    mxArray* properties = mxGetField(materials, index, "properties");
+    const int key_field = mexximp::field_number(properties, "key");
+    const int data_field = mexximp::field_number(properties, "data");
+    if (0 == texture_offset || 0 > key_field || 0 > data_field) {
+        return;
+    }
+    
+    unsigned num_properties = mxGetNumberOfElements(properties);
+    for (unsigned p = 0; p < num_properties; p++) {
+        std::string key = string_value(mxGetFieldByNumber(properties, p, key_field));
+        if ("texture" != key && _AI_MATKEY_TEXTURE_BASE != key) {
+            continue;
+        }
+        
+        std::string data = string_value(mxGetFieldByNumber(properties, p, data_field));
+        char* end = 0;
+        long texture_index = 1 < data.size() && '*' == data[0] ? strtol(&data[1], &end, 10) : -1;
+        if (0 > texture_index || !end || '\0' != *end) {
+            continue;
+        }
+        
+        char reference[32];
+        snprintf(reference, sizeof(reference), "*%lu", (unsigned long)texture_index + texture_offset);
+        replace_field(properties, p, data_field, mxCreateString(reference));
+    }
+}
+
+// parse inputs
+
+static bool read_parts(const mxArray* outer, const mxArray* inners, const mxArray* transforms, const mxArray* prefixes,
+        std::vector<scene_part>* parts) {
+    scene_part outer_part = {outer, 0, 0, "", 0, 0, 0};
+    parts->push_back(outer_part);
+    
+    unsigned num_inners = mxGetNumberOfElements(inners);
+    for (unsigned k = 0; k < num_inners; k++) {
+        scene_part part = {inners, k, 0, "", 0, 0, 0};
+        if (mxIsCell(inners)) {
+            part.scene = mxGetCell(inners, k);
+            part.index = 0;
+        }
+        if (!part.scene || !mxIsStruct(part.scene) || part.index >= mxGetNumberOfElements(part.scene)) {
+            mexPrintf("Inner scene %u is not a scene struct.\n", k + 1);
+            return false;
+        }
+        
+        const mxArray* root_node = scene_field(part, "rootNode");
+        if (root_node && 0 <= mxGetFieldNumber(root_node, "parents")) {
+            mexPrintf("Inner scene %u has flat nodes, which can't be combined.\n", k + 1);
+            return false;
+        }
+        
+        if (transforms && !mxIsEmpty(transforms)) {
+            if (!mxIsDouble(transforms) || 16 * num_inners != mxGetNumberOfElements(transforms)) {
+                mexPrintf("Expected 4x4x%u double importTransforms.\n", num_inners);
+                return false;
+            }
+            part.import_transform = mxGetPr(transforms) + 16 * k;
+        }
+        
+        const mxArray* prefix = 0;
+        if (prefixes && mxIsChar(prefixes)) {
+            prefix = prefixes;
+        } else if (prefixes && mxIsCell(prefixes) && k < mxGetNumberOfElements(prefixes)) {
+            prefix = mxGetCell(prefixes, k);
+        }
+        if (prefix && mxIsChar(prefix)) {
+            char* prefix_string = mxArrayToString(prefix);
+            part.prefix = prefix_string ? prefix_string : "";
+            mxFree(prefix_string);
+        }
+        
+        parts->push_back(part);
+    }
+    return true;
+}
+
+static mxArray* combine_scenes(std::vector<scene_part>& parts) {
+    unsigned num_parts = parts.size();
+    std::vector<const mxArray*> materials(num_parts);
+    std::vector<const mxArray*> meshes(num_parts);
+    std::vector<const mxArray*> textures(num_parts);
+    std::vector<const mxArray*> children(num_parts);
+    for (unsigned k = 0; k < num_parts; k++) {
+        materials[k] = scene_field(parts[k], "materials");
+        meshes[k] = scene_field(parts[k], "meshes");
+        textures[k] = scene_field(parts[k], "embeddedTextures");
+        const mxArray* root_node = scene_field(parts[k], "rootNode");
+        children[k] = root_node && !mxIsEmpty(root_node) ? mxGetField(root_node, 0, "children") : 0;
+    }
+    
+    // copy each element once
+    std::vector<unsigned> material_starts;
+    std::vector<unsigned> mesh_starts;
+    std::vector<unsigned> texture_starts;
+    std::vector<unsigned> child_starts;
+    mxArray* combined_materials = concatenate_structs(materials, &material_starts);
+    mxArray* combined_meshes = concatenate_structs(meshes, &mesh_starts);
+    mxArray* combined_textures = concatenate_structs(textures, &texture_starts);
+    mxArray* combined_children = concatenate_structs(children, &child_starts);
+    
+    // fix up inner elements in place
+    const int mesh_name_field = mexximp::field_number(combined_meshes, "name");
+    const int material_index_field = mexximp::field_number(combined_meshes, "materialIndex");
+    const int node_name_field = mexximp::field_number(combined_children, "name");
+    const int transformation_field = mexximp::field_number(combined_children, "transformation");
+    for (unsigned k = 1; k < num_parts; k++) {
+        scene_part& part = parts[k];
+        part.material_offset = material_starts[k];
+        part.mesh_offset = mesh_starts[k];
+        part.texture_offset = texture_starts[k];
+        
+        unsigned num_materials = num_structs(materials[k]);
+        for (unsigned i = material_starts[k]; i < material_starts[k] + num_materials; i++) {
+            offset_texture_references(combined_materials, i, part.texture_offset);
+        }
+        
+        unsigned num_meshes = num_structs(meshes[k]);
+        for (unsigned i = mesh_starts[k]; i < mesh_starts[k] + num_meshes; i++) {
+            prefix_name(combined_meshes, i, mesh_name_field, part.prefix);
+            offset_indices(mexximp::get_field(combined_meshes, i, material_index_field), part.material_offset);
+        }
+        
+        unsigned num_children = num_structs(children[k]);
+        for (unsigned i = child_starts[k]; i < child_starts[k] + num_children; i++) {
+            prefix_name(combined_children, i, node_name_field, part.prefix);
+            premultiply_transformation(combined_children, i, transformation_field, part.import_transform);
+            offset_subtree_meshes(combined_children, i, part.mesh_offset);
+        }
+    }
+    
+    // outer scene and root node, except for the combined parts
+    static const char* scene_skip_names[] = {"materials", "meshes", "embeddedTextures", "rootNode"};
+    static const char* root_skip_names[] = {"children"};
+    
+    mxArray* combined = copy_struct_except(parts[0].scene, parts[0].index, scene_skip_names, COUNT(scene_skip_names));
+    mxSetField(combined, 0, "materials", combined_materials);
+    mxSetField(combined, 0, "meshes", combined_meshes);
+    mxSetField(combined, 0, "embeddedTextures", combined_textures);
+    
+    const mxArray* outer_root = mxGetField(parts[0].scene, parts[0].index, "rootNode");
+    if (outer_root && mxIsStruct(outer_root) && !mxIsEmpty(outer_root)) {
+        mxArray* combined_root = copy_struct_except(outer_root, 0, root_skip_names, COUNT(root_skip_names));
+        mxSetField(combined_root, 0, "children", combined_children);
+        mxSetField(combined, 0, "rootNode", combined_root);
+    } else {
+        mxDestroyArray(combined_children);
+        if (outer_root) {
+            mxSetField(combined, 0, "rootNode", mxDuplicateArray(outer_root));
+        }
+    }
+    
+    return combined;
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    if (nrhs < 2 || !mxIsStruct(prhs[0]) || mxIsEmpty(prhs[0]) || !(mxIsStruct(prhs[1]) || mxIsCell(prhs[1]))) {
+        printUsage();
+        plhs[0] = mexximp::emptyDouble();
+        return;
+    }
+    
+    const mxArray* outer_root = mxGetField(prhs[0], 0, "rootNode");
+    if (outer_root && mxIsStruct(outer_root) && 0 <= mxGetFieldNumber(outer_root, "parents")) {
+        mexPrintf("Outer scene has flat nodes, which can't be combined.\n");
+        plhs[0] = mexximp::emptyDouble();
+        return;
+    }
+    
+    std::vector<scene_part> parts;
+    const mxArray* transforms = 2 < nrhs ? prhs[2] : 0;
+    const mxArray* prefixes = 3 < nrhs ? prhs[3] : 0;
+    if (!read_parts(prhs[0], prhs[1], transforms, prefixes, &parts)) {
+        plhs[0] = mexximp::emptyDouble();
+        return;
+    }
+    
+    plhs[0] = combine_scenes(parts);
+}
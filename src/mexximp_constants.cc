@@ -21,6 +21,11 @@ static const char* constant_names[] = {
     "textureType",
     "materialPropertyKey",
     "postprocessStep",
+    "importOption",
+    "exportOption",
+    "exportTarget",
+    "configProperty",
+    "configPropertyType",
 };
 
 static const mxArray* constant_values[COUNT(constant_names)];
@@ -44,6 +49,11 @@ static const void populate_values() {
     constant_values[i++] = mexximp::create_string_cell(mexximp::texture_type_strings, COUNT(mexximp::texture_type_strings));
     constant_values[i++] = mexximp::create_string_cell(mexximp::nice_key_strings, COUNT(mexximp::nice_key_strings));
     constant_values[i++] = mexximp::postprocess_step_struct(0);
+    constant_values[i++] = mexximp::import_option_struct(mexximp::import_options());
+    constant_values[i++] = mexximp::export_option_struct(mexximp::matlab_export_options());
+    constant_values[i++] = mexximp::create_blank_struct(mexximp::export_target_field_names, COUNT(mexximp::export_target_field_names));
+    constant_values[i++] = mexximp::create_blank_struct(mexximp::config_property_field_names, COUNT(mexximp::config_property_field_names));
+    constant_values[i++] = mexximp::create_string_cell(mexximp::config_property_type_strings, COUNT(mexximp::config_property_type_strings));
 }
 
 void printUsage() {
@@ -66,7 +76,8 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
     }
     
     char* whichConstant = mxArrayToString(prhs[0]);
-    int index = mexximp::string_index(constant_names, COUNT(constant_names), whichConstant);
+    static const mexximp::string_lookup lookup(constant_names, COUNT(constant_names));
+    int index = lookup.index(whichConstant);
     
     if (0 > index) {
         plhs[0] = mexximp::emptyDouble();
@@ -6,9 +6,14 @@
 #ifndef MEXXIMP_CONSTANTS_H_
 #define MEXXIMP_CONSTANTS_H_
 
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include "mexximp_util.h"
+#include "mexximp_scene.h"
 
 #define COUNT(x) ((sizeof x) / (sizeof x[0]))
 
@@ -88,11 +93,41 @@ namespace mexximp {
         "textureCoordinates7",
     };
     
+    // name, materialIndex, and primitiveTypes are imported even when not selected
+    static const unsigned mesh_required_fields = 0x7;
+    
+    static const char* mesh_colors_field_names[] = {
+        "colors0",
+        "colors1",
+        "colors2",
+        "colors3",
+        "colors4",
+        "colors5",
+        "colors6",
+        "colors7",
+    };
+    
+    static const char* mesh_texture_coordinates_field_names[] = {
+        "textureCoordinates0",
+        "textureCoordinates1",
+        "textureCoordinates2",
+        "textureCoordinates3",
+        "textureCoordinates4",
+        "textureCoordinates5",
+        "textureCoordinates6",
+        "textureCoordinates7",
+    };
+    
     static const char* face_field_names[] = {
         "nIndices",
         "indices",
     };
     
+    static const char* packed_face_field_names[] = {
+        "faceOffsets",
+        "faceIndices",
+    };
+    
     static const char* node_field_names[] = {
         "name",
         "meshIndices",
@@ -100,6 +135,14 @@ namespace mexximp {
         "children",
     };
     
+    static const char* flat_node_field_names[] = {
+        "names",
+        "parents",
+        "transformations",
+        "meshOffsets",
+        "meshIndices",
+    };
+    
     static const char* texture_field_names[] = {
         "image",
         "format",
@@ -128,6 +171,76 @@ namespace mexximp {
         return -1;
     }
     
+    // FNV-1a hash of a string constant
+    inline uint32_t string_hash(const char* string) {
+        uint32_t hash = 2166136261u;
+        for (; *string; string++) {
+            hash = (hash ^ (unsigned char)*string) * 16777619u;
+        }
+        return hash;
+    }
+    
+    // hashed index of declared string constants, built once per table on first use
+    //  open addressing with at most half the slots full, so a miss usually costs one strcmp or none
+    struct string_lookup {
+        const char** declared;
+        uint32_t mask;
+        std::vector<int> slots;
+        
+        string_lookup(const char* declared_strings[], unsigned num_declared) : declared(declared_strings) {
+            uint32_t num_slots = 4;
+            while (num_slots < 2 * num_declared) {
+                num_slots *= 2;
+            }
+            mask = num_slots - 1;
+            slots.assign(num_slots, -1);
+            
+            // insert in reverse so the first of any duplicate strings wins
+            for (unsigned i = num_declared; i > 0; i--) {
+                uint32_t slot = string_hash(declared[i - 1]) & mask;
+                while (0 <= slots[slot] && 0 != strcmp(declared[slots[slot]], declared[i - 1])) {
+                    slot = (slot + 1) & mask;
+                }
+                slots[slot] = i - 1;
+            }
+        }
+        
+        int index(const char* string) const {
+            if (!string) {
+                return -1;
+            }
+            for (uint32_t slot = string_hash(string) & mask; 0 <= slots[slot]; slot = (slot + 1) & mask) {
+                if (0 == strcmp(declared[slots[slot]], string)) {
+                    return slots[slot];
+                }
+            }
+            return -1;
+        }
+    };
+    
+    // direct index of declared small, non-negative integer constants, like Assimp enums
+    struct code_lookup {
+        std::vector<int> indices;
+        
+        code_lookup(const int declared[], unsigned num_declared) {
+            for (unsigned i = 0; i < num_declared; i++) {
+                if (0 > declared[i]) {
+                    continue;
+                }
+                if (indices.size() <= (unsigned)declared[i]) {
+                    indices.resize(declared[i] + 1, -1);
+                }
+                if (0 > indices[declared[i]]) {
+                    indices[declared[i]] = i;
+                }
+            }
+        }
+        
+        int index(int code) const {
+            return 0 <= code && (unsigned)code < indices.size() ? indices[code] : -1;
+        }
+    };
+    
     // get some declared strings as a cell array of strings
     inline mxArray* create_string_cell(const char* declared[], unsigned num_declared) {
         if (!declared) {
@@ -249,19 +362,327 @@ namespace mexximp {
         
         int codes = 0;
         
-        for (unsigned i=0; i<COUNT(prosprocess_step_strings); i++) {
-            const char* string = prosprocess_step_strings[i];
-            int code = prosprocess_step_values[i];
+        // visit the fields that are present, instead of looking up every step by name
+        static const string_lookup lookup(prosprocess_step_strings, COUNT(prosprocess_step_strings));
+        unsigned num_fields = mxIsStruct(steps) ? mxGetNumberOfFields(steps) : 0;
+        for (unsigned f=0; f<num_fields; f++) {
+            int index = lookup.index(mxGetFieldNameByNumber(steps, f));
+            if (0 > index) {
+                continue;
+            }
             
-            mxArray* step = mxGetField(steps, 0, string);
+            mxArray* step = mxGetFieldByNumber(steps, 0, f);
             if (step && mxIsLogicalScalarTrue(step)) {
-                codes |= code;
+                codes |= prosprocess_step_values[index];
             }
         }
         
         return codes;
     }
     
+    // config properties <-> struct
+    
+    static const char* config_property_field_names[] = {
+        "name",
+        "type",
+        "value",
+    };
+    
+    static const char* config_property_type_strings[] = {
+        "integer",
+        "float",
+        "string",
+        "matrix",
+    };
+    
+    inline mxArray* config_property_struct(const std::vector<config_property>& config) {
+        mxArray* matlab_config = mxCreateStructMatrix(1, config.size(), COUNT(config_property_field_names), &config_property_field_names[0]);
+        if (!matlab_config) {
+            return 0;
+        }
+        
+        for (unsigned i = 0; i < config.size(); i++) {
+            const config_property& property = config[i];
+            mxSetField(matlab_config, i, "name", mxCreateString(property.name.c_str()));
+            mxSetField(matlab_config, i, "type", mxCreateString(config_property_type_strings[property.type]));
+            
+            mxArray* value;
+            switch (property.type) {
+                case config_integer:
+                    value = mxCreateDoubleScalar(property.integer_value);
+                    break;
+                case config_float:
+                    value = mxCreateDoubleScalar(property.float_value);
+                    break;
+                case config_string:
+                    value = mxCreateString(property.string_value.c_str());
+                    break;
+                default:
+                    // like to_matlab_4x4, Assimp rows become Matlab columns
+                    // built here so mexximpConstants doesn't need mexximp_util.cc
+                    value = mxCreateDoubleMatrix(4, 4, mxREAL);
+                    for (unsigned r = 0; r < 4; r++) {
+                        for (unsigned c = 0; c < 4; c++) {
+                            mxGetPr(value)[c + 4 * r] = property.matrix_value[r][c];
+                        }
+                    }
+                    break;
+            }
+            mxSetField(matlab_config, i, "value", value);
+        }
+        
+        return matlab_config;
+    }
+    
+    // type comes from the type field, or else from the value: char is a string, 4x4 is a matrix, integer or logical is an integer,
+    // a whole number is both an integer and a float property, otherwise float
+    inline std::vector<config_property> config_property_values(const mxArray* matlab_config) {
+        std::vector<config_property> config;
+        if (!matlab_config || !mxIsStruct(matlab_config)) {
+            return config;
+        }
+        
+        unsigned num_properties = mxGetNumberOfElements(matlab_config);
+        for (unsigned i = 0; i < num_properties; i++) {
+            const mxArray* name = mxGetField(matlab_config, i, "name");
+            const mxArray* type = mxGetField(matlab_config, i, "type");
+            const mxArray* value = mxGetField(matlab_config, i, "value");
+            if (!name || !mxIsChar(name) || !value || mxIsEmpty(value)) {
+                continue;
+            }
+            
+            config_property property;
+            bool also_float = false;
+            if (type && mxIsChar(type) && !mxIsEmpty(type)) {
+                char* type_string = mxArrayToString(type);
+                static const string_lookup lookup(config_property_type_strings, COUNT(config_property_type_strings));
+                int index = lookup.index(type_string);
+                mxFree(type_string);
+                if (0 > index) {
+                    continue;
+                }
+                property.type = (config_property_type)index;
+            } else if (mxIsChar(value)) {
+                property.type = config_string;
+            } else if (mxIsDouble(value) && 16 == mxGetNumberOfElements(value)) {
+                property.type = config_matrix;
+            } else if (mxIsLogical(value) || (mxIsNumeric(value) && !mxIsDouble(value) && !mxIsSingle(value))) {
+                property.type = config_integer;
+            } else if (mxIsNumeric(value) && !mxIsComplex(value) && mxGetScalar(value) == floor(mxGetScalar(value))) {
+                // Assimp keeps integer and float properties apart, and reads knobs like PP_SLM_VERTEX_LIMIT as integers
+                // but PP_GSN_MAX_SMOOTHING_ANGLE as a float, so whole numbers are set as both
+                property.type = config_integer;
+                also_float = true;
+            } else {
+                property.type = config_float;
+            }
+            
+            switch (property.type) {
+                case config_integer:
+                case config_float:
+                    if (!mxIsNumeric(value) && !mxIsLogical(value)) {
+                        continue;
+                    }
+                    property.integer_value = mxGetScalar(value);
+                    property.float_value = mxGetScalar(value);
+                    break;
+                case config_string: {
+                    if (!mxIsChar(value)) {
+                        continue;
+                    }
+                    char* string = mxArrayToString(value);
+                    property.string_value = string;
+                    mxFree(string);
+                    break;
+                }
+                default:
+                    if (!mxIsDouble(value) || 16 != mxGetNumberOfElements(value)) {
+                        continue;
+                    }
+                    for (unsigned r = 0; r < 4; r++) {
+                        for (unsigned c = 0; c < 4; c++) {
+                            property.matrix_value[r][c] = mxGetPr(value)[c + 4 * r];
+                        }
+                    }
+                    break;
+            }
+            
+            char* name_string = mxArrayToString(name);
+            property.name = name_string;
+            mxFree(name_string);
+            
+            config.push_back(property);
+            if (also_float) {
+                property.type = config_float;
+                config.push_back(property);
+            }
+        }
+        
+        return config;
+    }
+    
+    // import options to and from struct
+    
+    static const char* import_option_strings[] = {
+        "packedFaces",
+        "singlePrecision",
+        "numThreads",
+        "useCache",
+        "meshFields",
+        "flatNodes",
+        "meshBounds",
+        "memoryMap",
+        "config",
+    };
+    
+    inline mxArray* import_option_struct(const import_options& options) {
+        mxArray* matlab_options = create_blank_struct(import_option_strings, COUNT(import_option_strings));
+        if (!matlab_options) {
+            return 0;
+        }
+        
+        mxSetField(matlab_options, 0, "packedFaces", mxCreateLogicalScalar(options.packed_faces));
+        mxSetField(matlab_options, 0, "singlePrecision", mxCreateLogicalScalar(options.single_precision));
+        mxSetField(matlab_options, 0, "numThreads", mxCreateDoubleScalar(options.num_threads));
+        mxSetField(matlab_options, 0, "useCache", mxCreateLogicalScalar(options.use_cache));
+        
+        unsigned num_mesh_fields = 0;
+        for (unsigned i = 0; i < COUNT(mesh_field_names); i++) {
+            num_mesh_fields += (options.mesh_fields >> i) & 1;
+        }
+        mxArray* mesh_fields = mxCreateCellMatrix(1, num_mesh_fields);
+        for (unsigned i = 0, f = 0; i < COUNT(mesh_field_names); i++) {
+            if ((options.mesh_fields >> i) & 1) {
+                mxSetCell(mesh_fields, f++, mxCreateString(mesh_field_names[i]));
+            }
+        }
+        mxSetField(matlab_options, 0, "meshFields", mesh_fields);
+        mxSetField(matlab_options, 0, "flatNodes", mxCreateLogicalScalar(options.flat_nodes));
+        mxSetField(matlab_options, 0, "meshBounds", mxCreateLogicalScalar(options.mesh_bounds));
+        mxSetField(matlab_options, 0, "memoryMap", mxCreateLogicalScalar(options.memory_map));
+        mxSetField(matlab_options, 0, "config", config_property_struct(options.config));
+        
+        return matlab_options;
+    }
+    
+    inline import_options import_option_values(const mxArray* matlab_options) {
+        import_options options;
+        if (!matlab_options || !mxIsStruct(matlab_options)) {
+            return options;
+        }
+        
+        mxArray* packed_faces = mxGetField(matlab_options, 0, "packedFaces");
+        options.packed_faces = packed_faces && mxIsLogicalScalarTrue(packed_faces);
+        
+        mxArray* single_precision = mxGetField(matlab_options, 0, "singlePrecision");
+        options.single_precision = single_precision && mxIsLogicalScalarTrue(single_precision);
+        
+        mxArray* num_threads = mxGetField(matlab_options, 0, "numThreads");
+        if (num_threads && mxIsNumeric(num_threads) && !mxIsEmpty(num_threads) && mxGetScalar(num_threads) >= 0) {
+            options.num_threads = mxGetScalar(num_threads);
+        }
+        
+        mxArray* use_cache = mxGetField(matlab_options, 0, "useCache");
+        options.use_cache = use_cache && mxIsLogicalScalarTrue(use_cache);
+        
+        mxArray* mesh_fields = mxGetField(matlab_options, 0, "meshFields");
+        if (mesh_fields && mxIsCell(mesh_fields)) {
+            options.mesh_fields = mesh_required_fields;
+            unsigned num_mesh_fields = mxGetNumberOfElements(mesh_fields);
+            for (unsigned i = 0; i < num_mesh_fields; i++) {
+                char* field_name = mxArrayToString(mxGetCell(mesh_fields, i));
+                static const string_lookup lookup(mesh_field_names, COUNT(mesh_field_names));
+                int index = lookup.index(field_name);
+                if (0 <= index) {
+                    options.mesh_fields |= 1u << index;
+                }
+                mxFree(field_name);
+            }
+        }
+        
+        mxArray* flat_nodes = mxGetField(matlab_options, 0, "flatNodes");
+        options.flat_nodes = flat_nodes && mxIsLogicalScalarTrue(flat_nodes);
+        
+        mxArray* mesh_bounds = mxGetField(matlab_options, 0, "meshBounds");
+        options.mesh_bounds = mesh_bounds && mxIsLogicalScalarTrue(mesh_bounds);
+        
+        mxArray* memory_map = mxGetField(matlab_options, 0, "memoryMap");
+        options.memory_map = memory_map && mxIsLogicalScalarTrue(memory_map);
+        
+        options.config = config_property_values(mxGetField(matlab_options, 0, "config"));
+        
+        return options;
+    }
+    
+    // one of several export targets for the same scene
+    
+    static const char* export_target_field_names[] = {
+        "format",
+        "file",
+        "postprocessSteps",
+    };
+    
+    // export options <-> struct
+    
+    static const char* export_option_strings[] = {
+        "numThreads",
+        "borrowSingles",
+        "arenaAllocation",
+        "toBlob",
+        "config",
+    };
+    
+    // defaults for mex-functions that install borrowed_buffers_guard, which can borrow single-precision data
+    inline export_options matlab_export_options() {
+        export_options options;
+        options.borrow_singles = true;
+        return options;
+    }
+    
+    inline mxArray* export_option_struct(const export_options& options) {
+        mxArray* matlab_options = create_blank_struct(export_option_strings, COUNT(export_option_strings));
+        if (!matlab_options) {
+            return 0;
+        }
+        
+        mxSetField(matlab_options, 0, "numThreads", mxCreateDoubleScalar(options.num_threads));
+        mxSetField(matlab_options, 0, "borrowSingles", mxCreateLogicalScalar(options.borrow_singles));
+        mxSetField(matlab_options, 0, "arenaAllocation", mxCreateLogicalScalar(options.use_arena));
+        mxSetField(matlab_options, 0, "toBlob", mxCreateLogicalScalar(options.to_blob));
+        mxSetField(matlab_options, 0, "config", config_property_struct(options.config));
+        
+        return matlab_options;
+    }
+    
+    inline export_options export_option_values(const mxArray* matlab_options) {
+        export_options options = matlab_export_options();
+        if (!matlab_options || !mxIsStruct(matlab_options)) {
+            return options;
+        }
+        
+        mxArray* num_threads = mxGetField(matlab_options, 0, "numThreads");
+        if (num_threads && mxIsNumeric(num_threads) && !mxIsEmpty(num_threads) && mxGetScalar(num_threads) >= 0) {
+            options.num_threads = mxGetScalar(num_threads);
+        }
+        
+        mxArray* borrow_singles = mxGetField(matlab_options, 0, "borrowSingles");
+        if (borrow_singles && mxIsLogicalScalar(borrow_singles)) {
+            options.borrow_singles = mxIsLogicalScalarTrue(borrow_singles);
+        }
+        
+        mxArray* use_arena = mxGetField(matlab_options, 0, "arenaAllocation");
+        if (use_arena && mxIsLogicalScalar(use_arena)) {
+            options.use_arena = mxIsLogicalScalarTrue(use_arena);
+        }
+        
+        mxArray* to_blob = mxGetField(matlab_options, 0, "toBlob");
+        options.to_blob = to_blob && mxIsLogicalScalarTrue(to_blob);
+        
+        options.config = config_property_values(mxGetField(matlab_options, 0, "config"));
+        
+        return options;
+    }
+    
     // mesh primitive type <-> struct
     
     static const char* mesh_primitive_strings[] = {
@@ -330,12 +751,14 @@ namespace mexximp {
     };
     
     inline const char* light_type_string(aiLightSourceType type_code) {
-        int index = integer_index((const int*)light_type_codes, COUNT(light_type_codes), type_code);
+        static const code_lookup lookup((const int*)light_type_codes, COUNT(light_type_codes));
+        int index = lookup.index(type_code);
         return index < 0 ? "unknown_code" : light_type_strings[index];
     }
     
     inline aiLightSourceType light_type_code(const char* type_string) {
-        int index = string_index(light_type_strings, COUNT(light_type_strings), type_string);
+        static const string_lookup lookup(light_type_strings, COUNT(light_type_strings));
+        int index = lookup.index(type_string);
         return index < 0 ? aiLightSource_UNDEFINED : light_type_codes[index];
     }
     
@@ -356,12 +779,14 @@ namespace mexximp {
     };
     
     inline const char* material_property_type_string(aiPropertyTypeInfo type_code) {
-        int index = integer_index((const int*)material_property_type_codes, COUNT(material_property_type_codes), type_code);
+        static const code_lookup lookup((const int*)material_property_type_codes, COUNT(material_property_type_codes));
+        int index = lookup.index(type_code);
         return index < 0 ? "unknown_code" : material_property_type_strings[index];
     }
     
     inline aiPropertyTypeInfo material_property_type_code(const char* type_string) {
-        int index = string_index(material_property_type_strings, COUNT(material_property_type_strings), type_string);
+        static const string_lookup lookup(material_property_type_strings, COUNT(material_property_type_strings));
+        int index = lookup.index(type_string);
         return index < 0 ? aiPTI_Buffer : material_property_type_codes[index];
     }
     
@@ -400,12 +825,14 @@ namespace mexximp {
     };
     
     inline const char* texture_type_string(aiTextureType type_code) {
-        int index = integer_index((const int*)texture_type_codes, COUNT(texture_type_codes), type_code);
+        static const code_lookup lookup((const int*)texture_type_codes, COUNT(texture_type_codes));
+        int index = lookup.index(type_code);
         return index < 0 ? "unknown_code" : texture_type_strings[index];
     }
     
     inline aiTextureType texture_type_code(const char* type_string) {
-        int index = string_index(texture_type_strings, COUNT(texture_type_strings), type_string);
+        static const string_lookup lookup(texture_type_strings, COUNT(texture_type_strings));
+        int index = lookup.index(type_string);
         return index < 0 ? aiTextureType_UNKNOWN : texture_type_codes[index];
     }
     
@@ -474,12 +901,14 @@ namespace mexximp {
     };
     
     inline const char* nice_key(const char* key) {
-        int index = string_index(ugly_key_strings, COUNT(ugly_key_strings), key);
+        static const string_lookup lookup(ugly_key_strings, COUNT(ugly_key_strings));
+        int index = lookup.index(key);
         return index < 0 ? "unknown_key" : nice_key_strings[index];
     }
     
     inline const char* ugly_key(const char* key) {
-        int index = string_index(nice_key_strings, COUNT(nice_key_strings), key);
+        static const string_lookup lookup(nice_key_strings, COUNT(nice_key_strings));
+        int index = lookup.index(key);
         return index < 0 ? "unknown_key" : ugly_key_strings[index];
     }
 }
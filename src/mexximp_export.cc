@@ -1,15 +1,36 @@
 
+#include <cstring>
+#include <sys/stat.h>
 #include <mex.h>
+#include <memory>
+#include <string>
+#include <vector>
 #include <assimp/Exporter.hpp>
 #include "mexximp_constants.h"
+#include "mexximp_io.h"
 #include "mexximp_scene.h"
+#include "mexximp_threads.h"
+#include "mexximp_timing.h"
 
 void printUsage() {
     Assimp::Exporter exporter;
     
     mexPrintf("Export a scene file:\n");
-    mexPrintf("  status = mexximpExport(scene, format, sceneFile, postprocessSteps)\n");
+    mexPrintf("  status = mexximpExport(scene, format, sceneFile, postprocessSteps, exportOptions)\n");
     mexPrintf("  see mexximpConstants('postprocessStep') for sample postprocessSteps\n");
+    mexPrintf("  see mexximpConstants('exportOption') for sample exportOptions\n");
+    mexPrintf("Export to uint8 arrays instead of files, when exportOptions.toBlob is true:\n");
+    mexPrintf("  [status, blobs] = mexximpExport(scene, format, sceneFile, postprocessSteps, exportOptions)\n");
+    mexPrintf("  blobs is a struct array with the name and uint8 data of the main file and any side files\n");
+    mexPrintf("  names come from sceneFile, which is not written\n");
+    mexPrintf("Report time spent converting each part of the scene, and exporting:\n");
+    mexPrintf("  [status, blobs, timing] = mexximpExport(scene, format, sceneFile, postprocessSteps, exportOptions)\n");
+    mexPrintf("  timing is a struct array with wall-clock and CPU seconds, element count, and bytes for each phase\n");
+    mexPrintf("Export the same scene to several targets, written on exportOptions.numThreads threads:\n");
+    mexPrintf("  [status, errors, blobs] = mexximpExport(scene, targets, exportOptions)\n");
+    mexPrintf("  see mexximpConstants('exportTarget') for a sample target with format, file, and postprocessSteps\n");
+    mexPrintf("  status is 0 for each target that was written, errors holds an error message for each target that wasn't\n");
+    mexPrintf("  [status, errors, blobs, timing] = mexximpExport(scene, targets, exportOptions) also reports timing\n");
     mexPrintf("The following formats are supported:\n");
     
     unsigned num_formats = exporter.GetExportFormatCount();
@@ -24,41 +45,246 @@ void printUsage() {
     mexPrintf("\n");
 }
 
+struct exportTarget {
+    std::string format;
+    std::string file;
+    unsigned postprocessFlags;
+    aiReturn status;
+    std::string error;
+    
+    // with exportOptions.toBlob, the Exporter owns the blobs until they're copied to Matlab
+    std::shared_ptr<Assimp::Exporter> exporter;
+    const aiExportDataBlob* blob;
+};
+
+static const char* blob_field_names[] = {
+    "name",
+    "data",
+};
+
+// main blob named like the target file, side blobs named by the extension Assimp gives them
+mxArray* blobStruct(const exportTarget& target) {
+    unsigned num_blobs = 0;
+    for (const aiExportDataBlob* blob = target.blob; blob; blob = blob->next) {
+        num_blobs++;
+    }
+    
+    std::string name = mexximp::base_name(target.file);
+    std::string stem = name.substr(0, name.find_last_of('.'));
+    
+    mxArray* blobs = mxCreateStructMatrix(1, num_blobs, COUNT(blob_field_names), &blob_field_names[0]);
+    unsigned i = 0;
+    for (const aiExportDataBlob* blob = target.blob; blob; blob = blob->next, i++) {
+        std::string blobName = blob->name.C_Str();
+        if (blob == target.blob) {
+            blobName = name;
+        } else if (!stem.empty()) {
+            blobName = stem + "." + blobName;
+        }
+        mxSetField(blobs, i, "name", mxCreateString(blobName.c_str()));
+        
+        mxArray* data = mxCreateNumericMatrix(1, blob->size, mxUINT8_CLASS, mxREAL);
+        if (blob->size) {
+            memcpy(mxGetData(data), blob->data, blob->size);
+        }
+        mxSetField(blobs, i, "data", data);
+    }
+    return blobs;
+}
+
+// bytes written for the target, from its blobs or its file
+double exportedBytes(const exportTarget& target) {
+    if (AI_SUCCESS != target.status) {
+        return 0;
+    }
+    
+    if (target.blob) {
+        double bytes = 0;
+        for (const aiExportDataBlob* blob = target.blob; blob; blob = blob->next) {
+            bytes += blob->size;
+        }
+        return bytes;
+    }
+    
+    struct stat file_stat;
+    if (0 != stat(target.file.c_str(), &file_stat)) {
+        return 0;
+    }
+    return file_stat.st_size;
+}
+
+// read targets here on the Matlab thread, false for a target with no format or file
+bool readExportTarget(const mxArray* targets, unsigned index, exportTarget* target) {
+    target->postprocessFlags = 0;
+    target->status = aiReturn_FAILURE;
+    target->blob = 0;
+    
+    const mxArray* format = mxGetField(targets, index, "format");
+    const mxArray* file = mxGetField(targets, index, "file");
+    if (!format || !mxIsChar(format) || !file || !mxIsChar(file)) {
+        target->error = "Export target needs a format and a file name.";
+        return false;
+    }
+    
+    char* string = mxArrayToString(format);
+    target->format = string;
+    mxFree(string);
+    
+    string = mxArrayToString(file);
+    target->file = string;
+    mxFree(string);
+    
+    const mxArray* postprocessSteps = mxGetField(targets, index, "postprocessSteps");
+    if (postprocessSteps && mxIsStruct(postprocessSteps)) {
+        target->postprocessFlags = mexximp::postprocess_step_codes(postprocessSteps);
+    }
+    
+    return true;
+}
+
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
-    if (nrhs < 3 || !mxIsStruct(prhs[0]) || !mxIsChar(prhs[1]) || !mxIsChar(prhs[2])) {
+    bool batch = 2 <= nrhs && mxIsStruct(prhs[0]) && mxIsStruct(prhs[1]);
+    if (!batch && (nrhs < 3 || !mxIsStruct(prhs[0]) || !mxIsChar(prhs[1]) || !mxIsChar(prhs[2]))) {
         printUsage();
         plhs[0] = mexximp::emptyDouble();
         return;
     }
     
-    unsigned postprocessFlags = 0;
-    if (3 < nrhs && mxIsStruct(prhs[3])) {
-        postprocessFlags = mexximp::postprocess_step_codes(prhs[3]);
+    // a single target comes from the format, file, and postprocess arguments
+    std::vector<exportTarget> targets;
+    const mxArray* matlab_options = 0;
+    if (batch) {
+        unsigned num_targets = mxGetNumberOfElements(prhs[1]);
+        targets.resize(num_targets);
+        for (unsigned i = 0; i < num_targets; i++) {
+            readExportTarget(prhs[1], i, &targets[i]);
+        }
+        matlab_options = 2 < nrhs ? prhs[2] : 0;
+        
+    } else {
+        targets.resize(1);
+        exportTarget& target = targets[0];
+        target.status = aiReturn_FAILURE;
+        target.blob = 0;
+        
+        target.postprocessFlags = 0;
+        if (3 < nrhs && mxIsStruct(prhs[3])) {
+            target.postprocessFlags = mexximp::postprocess_step_codes(prhs[3]);
+        }
+        
+        char* format = mxArrayToString(prhs[1]);
+        target.format = format;
+        mxFree(format);
+        
+        char* sceneFile = mxArrayToString(prhs[2]);
+        target.file = sceneFile;
+        mxFree(sceneFile);
+        
+        matlab_options = 4 < nrhs ? prhs[4] : 0;
     }
     
+    mexximp::export_options options = mexximp::matlab_export_options();
+    if (matlab_options && mxIsStruct(matlab_options)) {
+        options = mexximp::export_option_values(matlab_options);
+    }
+    
+    // borrowed single-precision arrays and arena arrays are detached before the scene is destroyed
     aiScene scene;
-    unsigned count = mexximp::to_assimp_scene(prhs[0], &scene);
+    mexximp::arena scene_arena;
+    mexximp::arena* arena = options.use_arena ? &scene_arena : 0;
+    mexximp::borrowed_buffers_guard guard(prhs[0], &scene, arena);
+    
+    // timing comes last, after status and blobs or errors and blobs
+    int timingIndex = batch ? 3 : 2;
+    mexximp::timing_report report;
+    mexximp::timing_report* timing = timingIndex < nlhs ? &report : 0;
+    
+    unsigned count = mexximp::to_assimp_scene(prhs[0], &scene, options, arena, timing);
     if (!count) {
         mexPrintf("Could not convert scene to Assimp format.\n");
         plhs[0] = mexximp::emptyDouble();
         return;
     }
     
-    char* format = mxArrayToString(prhs[1]);
-    const std::string& pFormat(format);
-    mxFree(format);
+    // shared by all targets, Exporters only read properties
+    Assimp::ExportProperties properties;
+    mexximp::apply_config(&properties, options.config);
     
-    char* sceneFile = mxArrayToString(prhs[2]);
-    const std::string& pFile(sceneFile);
-    mxFree(sceneFile);
+    mexximp::phase_timer exportTimer;
+    if (timing) {
+        exportTimer.start();
+    }
+    
+    // the scene is built once and only read from here on
+    // each target gets its own Exporter, which copies the scene before any postprocessing
+    mexximp::parallel_for(targets.size(), options.num_threads, [&](size_t i) {
+        exportTarget& target = targets[i];
+        if (target.format.empty() || (target.file.empty() && !options.to_blob)) {
+            return;
+        }
         
-    Assimp::Exporter exporter;
-    aiReturn status = exporter.Export(&scene, pFormat, pFile, postprocessFlags);
+        target.exporter.reset(new Assimp::Exporter());
+        if (options.to_blob) {
+            target.blob = target.exporter->ExportToBlob(&scene, target.format, target.postprocessFlags, &properties);
+            target.status = target.blob ? aiReturn_SUCCESS : aiReturn_FAILURE;
+        } else {
+            target.status = target.exporter->Export(&scene, target.format, target.file, target.postprocessFlags, &properties);
+        }
+        
+        if (AI_SUCCESS != target.status) {
+            const char* error = target.exporter->GetErrorString();
+            target.error = error ? error : "";
+        }
+    });
     
-    if(AI_SUCCESS != status) {
-        mexPrintf("%s\n", exporter.GetErrorString());
-        mexPrintf("\n");
+    if (timing) {
+        exportTimer.stop();
+        double numExported = 0;
+        double bytes = 0;
+        for (size_t i = 0; i < targets.size(); i++) {
+            numExported += AI_SUCCESS == targets[i].status;
+            bytes += exportedBytes(targets[i]);
+        }
+        report.add("export", exportTimer, numExported, bytes);
     }
     
-    plhs[0] = mxCreateDoubleScalar(status);
+    if (!batch) {
+        if (AI_SUCCESS != targets[0].status) {
+            mexPrintf("%s\n", targets[0].error.c_str());
+            mexPrintf("\n");
+        }
+        plhs[0] = mxCreateDoubleScalar(targets[0].status);
+        if (1 < nlhs) {
+            plhs[1] = blobStruct(targets[0]);
+        }
+        if (timing) {
+            plhs[2] = mexximp::timing_report_struct(report);
+        }
+        return;
+    }
+    
+    unsigned num_targets = targets.size();
+    plhs[0] = mxCreateDoubleMatrix(1, num_targets, mxREAL);
+    double* status = mxGetPr(plhs[0]);
+    for (unsigned i = 0; i < num_targets; i++) {
+        status[i] = targets[i].status;
+    }
+    
+    if (1 < nlhs) {
+        plhs[1] = mxCreateCellMatrix(1, num_targets);
+        for (unsigned i = 0; i < num_targets; i++) {
+            mxSetCell(plhs[1], i, mxCreateString(targets[i].error.c_str()));
+        }
+    }
+    
+    if (2 < nlhs) {
+        plhs[2] = mxCreateCellMatrix(1, num_targets);
+        for (unsigned i = 0; i < num_targets; i++) {
+            mxSetCell(plhs[2], i, blobStruct(targets[i]));
+        }
+    }
+    
+    if (timing) {
+        plhs[3] = mexximp::timing_report_struct(report);
+    }
 }
@@ -1,17 +1,54 @@
 
 
+#include <cstring>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 #include <mex.h>
 #include <assimp/Importer.hpp>
 #include <assimp/importerdesc.h>
+#include "mexximp_cache.h"
 #include "mexximp_constants.h"
+#include "mexximp_io.h"
+#include "mexximp_jobs.h"
 #include "mexximp_scene.h"
+#include "mexximp_threads.h"
+#include "mexximp_timing.h"
 
 void printUsage() {
     Assimp::Importer importer;
     
     mexPrintf("Import a scene file:\n");
-    mexPrintf("  scene = mexximpImport(sceneFile, postprocessSteps)\n");
+    mexPrintf("  scene = mexximpImport(sceneFile, postprocessSteps, importOptions)\n");
     mexPrintf("  see mexximpConstants('postprocessStep') for sample postprocessSteps\n");
+    mexPrintf("  see mexximpConstants('importOption') for sample importOptions\n");
+    mexPrintf("Report time spent reading, postprocessing, and converting each part of the scene:\n");
+    mexPrintf("  [scene, timing] = mexximpImport(sceneFile, postprocessSteps, importOptions)\n");
+    mexPrintf("  timing is a struct array with wall-clock and CPU seconds, element count, and bytes for each phase\n");
+    mexPrintf("Import many scene files at once, parsed on importOptions.numThreads threads:\n");
+    mexPrintf("  [scenes, status, errors] = mexximpImport(sceneFiles, postprocessSteps, importOptions)\n");
+    mexPrintf("  sceneFiles is a cell array of file names\n");
+    mexPrintf("  status is 0 for each file that imported, errors holds an error message for each file that didn't\n");
+    mexPrintf("Import a scene from bytes in memory, for example from an archive:\n");
+    mexPrintf("  scene = mexximpImport(sceneBytes, postprocessSteps, importOptions, formatHint, sideFiles)\n");
+    mexPrintf("  sceneBytes is a uint8 array, formatHint is a file extension like 'obj'\n");
+    mexPrintf("  sideFiles is a struct array with name and uint8 data for files the scene refers to, like .mtl or textures\n");
+    mexPrintf("Import a scene file in the background, while Matlab does other work:\n");
+    mexPrintf("  job = mexximpImport('-start', sceneFile, postprocessSteps, importOptions)\n");
+    mexPrintf("  info = mexximpImport('-poll', job)\n");
+    mexPrintf("  isFinished = mexximpImport('-wait', job, timeoutSeconds)\n");
+    mexPrintf("  mexximpImport('-cancel', job)\n");
+    mexPrintf("  scene = mexximpImport('-fetch', job)\n");
+    mexPrintf("Inspect or manage cached scenes, when importOptions.useCache is true:\n");
+    mexPrintf("  info = mexximpImport('-cache')\n");
+    mexPrintf("  info = mexximpImport('-cache', 'clear')\n");
+    mexPrintf("  info = mexximpImport('-cache', 'budget', budgetBytes)\n");
     mexPrintf("The following formats are supported:\n");
 
     unsigned num_formats = importer.GetImporterCount();
@@ -26,36 +63,455 @@ void printUsage() {
 
 }
 
+void manageCache(int nrhs, const mxArray *prhs[]) {
+    if (1 < nrhs && mxIsChar(prhs[1])) {
+        char* command = mxArrayToString(prhs[1]);
+        if (0 == strcmp("clear", command)) {
+            mexximp::cache_clear();
+        } else if (0 == strcmp("budget", command) && 2 < nrhs && mxIsNumeric(prhs[2]) && !mxIsEmpty(prhs[2])) {
+            mexximp::cache_set_budget(mxGetScalar(prhs[2]));
+        }
+        mxFree(command);
+    }
+}
+
+// move the fields of a 1x1 scene into one element of a scene struct array, and free the 1x1 shell
+void moveSceneFields(mxArray* scene, mxArray* scenes, unsigned index) {
+    unsigned num_fields = mxGetNumberOfFields(scene);
+    for (unsigned f = 0; f < num_fields; f++) {
+        const char* name = mxGetFieldNameByNumber(scene, f);
+        int field = mxGetFieldNumber(scenes, name);
+        if (0 > field) {
+            field = mxAddField(scenes, name);
+        }
+        mxSetFieldByNumber(scenes, index, field, mxGetFieldByNumber(scene, 0, f));
+        mxSetFieldByNumber(scene, 0, f, 0);
+    }
+    mxDestroyArray(scene);
+}
+
+// parse files on worker threads, each with its own Importer
+// convert each parsed scene to Matlab here, on the Matlab thread, as soon as it's ready
+void importBatch(int nlhs, mxArray *plhs[], const mxArray* sceneFiles, unsigned postprocessFlags, const mexximp::import_options& options) {
+    unsigned num_files = mxGetNumberOfElements(sceneFiles);
+    
+    mxArray* scenes = mxCreateStructMatrix(1, num_files, COUNT(mexximp::scene_field_names), &mexximp::scene_field_names[0]);
+    mxArray* status = mxCreateDoubleMatrix(1, num_files, mxREAL);
+    mxArray* errors = mxCreateCellMatrix(1, num_files);
+    double* status_data = mxGetPr(status);
+    
+    // file names and cache lookups need the mx API, so do them up front
+    std::vector<std::string> files(num_files);
+    std::vector<mexximp::cache_key> keys(num_files);
+    std::vector<bool> use_cache(num_files, false);
+    std::vector<unsigned> pending;
+    for (unsigned i = 0; i < num_files; i++) {
+        const mxArray* sceneFile = mxGetCell(sceneFiles, i);
+        if (!sceneFile || !mxIsChar(sceneFile)) {
+            status_data[i] = aiReturn_FAILURE;
+            mxSetCell(errors, i, mxCreateString("Scene file name must be a string."));
+            continue;
+        }
+        
+        char* fileName = mxArrayToString(sceneFile);
+        files[i] = fileName;
+        mxFree(fileName);
+        
+        use_cache[i] = options.use_cache && mexximp::make_cache_key(files[i], postprocessFlags, options, &keys[i]);
+        const mxArray* cached = use_cache[i] ? mexximp::cache_find(keys[i]) : 0;
+        if (cached) {
+            moveSceneFields(mxDuplicateArray(cached), scenes, i);
+            status_data[i] = aiReturn_SUCCESS;
+            mxSetCell(errors, i, mexximp::emptyString());
+            continue;
+        }
+        
+        pending.push_back(i);
+    }
+    
+    // workers hand over orphaned scenes, so each worker's Importer can go on to the next file
+    std::vector<aiScene*> parsed(num_files, (aiScene*)0);
+    std::vector<std::string> parseErrors(num_files);
+    std::deque<unsigned> ready;
+    std::mutex ready_mutex;
+    std::condition_variable ready_condition;
+    std::atomic<size_t> next(0);
+    
+    // nothing may throw out of a worker, that would terminate Matlab
+    auto work = [&]() {
+        // if the Importer can't be set up, each file this worker takes fails with the same error
+        std::unique_ptr<Assimp::Importer> importer;
+        std::string setupError;
+        try {
+            importer.reset(new Assimp::Importer());
+            mexximp::apply_config(importer.get(), options.config);
+            if (options.memory_map) {
+                mexximp::use_mmap_io(importer.get());
+            }
+        } catch (const std::exception& e) {
+            importer.reset();
+            setupError = e.what();
+        } catch (...) {
+            importer.reset();
+            setupError = "Unknown error while setting up scene importer.";
+        }
+        
+        for (size_t p = next++; p < pending.size(); p = next++) {
+            unsigned i = pending[p];
+            try {
+                if (!importer) {
+                    parseErrors[i] = setupError;
+                } else if (importer->ReadFile(files[i], postprocessFlags)) {
+                    parsed[i] = importer->GetOrphanedScene();
+                } else {
+                    parseErrors[i] = importer->GetErrorString();
+                }
+            } catch (const std::exception& e) {
+                parseErrors[i] = e.what();
+            } catch (...) {
+                parseErrors[i] = "Unknown error while reading scene file.";
+            }
+            
+            std::lock_guard<std::mutex> lock(ready_mutex);
+            ready.push_back(i);
+            ready_condition.notify_one();
+        }
+    };
+    
+    // at least one worker, so parsing overlaps conversion on this thread
+    unsigned num_workers = options.num_threads ? options.num_threads : mexximp::default_num_threads();
+    if (num_workers > pending.size()) {
+        num_workers = pending.size();
+    }
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < num_workers; t++) {
+        workers.push_back(std::thread(work));
+    }
+    
+    // if conversion fails, stop the workers and free what they parsed before passing on the error
+    auto finish = [&]() {
+        next = pending.size();
+        for (unsigned t = 0; t < workers.size(); t++) {
+            workers[t].join();
+        }
+        for (unsigned i = 0; i < num_files; i++) {
+            delete parsed[i];
+            parsed[i] = 0;
+        }
+    };
+    
+    try {
+        for (size_t done = 0; done < pending.size(); done++) {
+            unsigned i;
+            {
+                std::unique_lock<std::mutex> lock(ready_mutex);
+                ready_condition.wait(lock, [&]() { return !ready.empty(); });
+                i = ready.front();
+                ready.pop_front();
+            }
+            
+            if (!parsed[i]) {
+                status_data[i] = aiReturn_FAILURE;
+                mxSetCell(errors, i, mxCreateString(parseErrors[i].c_str()));
+                continue;
+            }
+            
+            mxArray* scene;
+            mexximp::to_matlab_scene(parsed[i], &scene, options);
+            delete parsed[i];
+            parsed[i] = 0;
+            
+            if (use_cache[i]) {
+                mexximp::cache_insert(keys[i], scene);
+            }
+            moveSceneFields(scene, scenes, i);
+            status_data[i] = aiReturn_SUCCESS;
+            mxSetCell(errors, i, mexximp::emptyString());
+        }
+    } catch (...) {
+        finish();
+        throw;
+    }
+    finish();
+    
+    plhs[0] = scenes;
+    if (1 < nlhs) {
+        plhs[1] = status;
+    } else {
+        mxDestroyArray(status);
+    }
+    if (2 < nlhs) {
+        plhs[2] = errors;
+    } else {
+        mxDestroyArray(errors);
+    }
+}
+
+// cached scenes and background jobs share the one exit function a mex-function gets
+void clearAll() {
+    mexximp::jobs_clear();
+    mexximp::cache_clear();
+}
+
+// postprocess steps and import options, starting at the given argument
+void readImportArgs(int nrhs, const mxArray *prhs[], int first, unsigned* postprocessFlags, mexximp::import_options* options) {
+    *postprocessFlags = 0;
+    if (first < nrhs && mxIsStruct(prhs[first])) {
+        *postprocessFlags = mexximp::postprocess_step_codes(prhs[first]);
+    }
+    
+    if (first + 1 < nrhs && mxIsStruct(prhs[first + 1])) {
+        *options = mexximp::import_option_values(prhs[first + 1]);
+    }
+}
+
+// start, poll, wait for, cancel, or fetch background jobs -- false for any other command
+bool manageJobs(int /* nlhs */, mxArray *plhs[], int nrhs, const mxArray *prhs[], const std::string& command) {
+    if (0 == command.compare("-start")) {
+        if (nrhs < 2 || !mxIsChar(prhs[1])) {
+            printUsage();
+            plhs[0] = mexximp::emptyDouble();
+            return true;
+        }
+        
+        char* sceneFile = mxArrayToString(prhs[1]);
+        std::string file(sceneFile);
+        mxFree(sceneFile);
+        
+        unsigned postprocessFlags;
+        mexximp::import_options options;
+        readImportArgs(nrhs, prhs, 2, &postprocessFlags, &options);
+        
+        plhs[0] = mxCreateDoubleScalar(mexximp::job_start(file, postprocessFlags, options));
+        return true;
+    }
+    
+    bool isJobCommand = 0 == command.compare("-poll")
+            || 0 == command.compare("-wait")
+            || 0 == command.compare("-cancel")
+            || 0 == command.compare("-fetch");
+    if (!isJobCommand) {
+        return false;
+    }
+    
+    if (nrhs < 2 || !mxIsNumeric(prhs[1]) || mxIsEmpty(prhs[1])) {
+        printUsage();
+        plhs[0] = mexximp::emptyDouble();
+        return true;
+    }
+    unsigned job = mxGetScalar(prhs[1]);
+    
+    if (0 == command.compare("-poll")) {
+        mxArray* info = mexximp::job_info(job);
+        plhs[0] = info ? info : mexximp::emptyDouble();
+        
+    } else if (0 == command.compare("-wait")) {
+        double timeoutSeconds = -1;
+        if (2 < nrhs && mxIsNumeric(prhs[2]) && !mxIsEmpty(prhs[2])) {
+            timeoutSeconds = mxGetScalar(prhs[2]);
+        }
+        plhs[0] = mxCreateLogicalScalar(mexximp::job_wait(job, timeoutSeconds));
+        
+    } else if (0 == command.compare("-cancel")) {
+        plhs[0] = mxCreateLogicalScalar(mexximp::job_cancel(job));
+        
+    } else {
+        std::string error;
+        mxArray* scene = mexximp::job_fetch(job, &error);
+        if (!scene) {
+            mexPrintf("%s\n", error.c_str());
+            mexPrintf("\n");
+            scene = mexximp::emptyDouble();
+        }
+        plhs[0] = scene;
+    }
+    
+    return true;
+}
+
+// all vertices in the scene, to measure reading throughput
+double countVertices(const aiScene* scene) {
+    double numVertices = 0;
+    for (unsigned i = 0; scene && i < scene->mNumMeshes; i++) {
+        numVertices += scene->mMeshes[i]->mNumVertices;
+    }
+    return numVertices;
+}
+
+// with a timing report, read and postprocess in two steps so each gets its own phase
+const aiScene* readScene(Assimp::Importer* importer, const std::string& sceneFile, unsigned postprocessFlags, mexximp::timing_report* timing) {
+    if (!timing) {
+        return importer->ReadFile(sceneFile, postprocessFlags);
+    }
+    
+    aiMemoryInfo memory;
+    mexximp::phase_timer readTimer;
+    readTimer.start();
+    const aiScene* scene = importer->ReadFile(sceneFile, 0);
+    readTimer.stop();
+    if (!scene) {
+        return 0;
+    }
+    importer->GetMemoryRequirements(memory);
+    timing->add("read", readTimer, countVertices(scene), memory.total);
+    
+    mexximp::phase_timer postprocessTimer;
+    postprocessTimer.start();
+    if (postprocessFlags) {
+        scene = importer->ApplyPostProcessing(postprocessFlags);
+    }
+    postprocessTimer.stop();
+    if (!scene) {
+        return 0;
+    }
+    importer->GetMemoryRequirements(memory);
+    timing->add("postprocess", postprocessTimer, countVertices(scene), memory.total);
+    
+    return scene;
+}
+
+// read a scene from a uint8 buffer and named side buffers, without touching the disk
+void importMemory(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    unsigned postprocessFlags;
+    mexximp::import_options options;
+    readImportArgs(nrhs, prhs, 1, &postprocessFlags, &options);
+    
+    // the file extension is how Assimp picks an importer
+    std::string sceneName("mexximp-memory-scene");
+    if (3 < nrhs && mxIsChar(prhs[3]) && !mxIsEmpty(prhs[3])) {
+        char* formatHint = mxArrayToString(prhs[3]);
+        sceneName += '.';
+        sceneName += '.' == formatHint[0] ? formatHint + 1 : formatHint;
+        mxFree(formatHint);
+    }
+    
+    // the Importer owns the IOSystem, the IOSystem borrows Matlab data
+    mexximp::memory_io_system* ioSystem = new mexximp::memory_io_system();
+    ioSystem->add_file(sceneName, mxGetData(prhs[0]), mxGetNumberOfElements(prhs[0]));
+    
+    if (4 < nrhs && mxIsStruct(prhs[4])) {
+        const mxArray* sideFiles = prhs[4];
+        unsigned num_files = mxGetNumberOfElements(sideFiles);
+        for (unsigned i = 0; i < num_files; i++) {
+            const mxArray* name = mxGetField(sideFiles, i, "name");
+            const mxArray* data = mxGetField(sideFiles, i, "data");
+            if (!name || !mxIsChar(name) || !data || !mxIsUint8(data)) {
+                mexPrintf("Skipping side file %d, which needs a name and uint8 data.\n", i + 1);
+                continue;
+            }
+            char* fileName = mxArrayToString(name);
+            ioSystem->add_file(fileName, mxGetData(data), mxGetNumberOfElements(data));
+            mxFree(fileName);
+        }
+    }
+    
+    Assimp::Importer importer;
+    mexximp::apply_config(&importer, options.config);
+    importer.SetIOHandler(ioSystem);
+    
+    mexximp::timing_report report;
+    mexximp::timing_report* timing = 1 < nlhs ? &report : 0;
+    const aiScene* scene = readScene(&importer, sceneName, postprocessFlags, timing);
+    
+    if(!scene) {
+        mexPrintf("%s\n", importer.GetErrorString());
+        mexPrintf("\n");
+        plhs[0] = mexximp::emptyDouble();
+    } else {
+        mexximp::to_matlab_scene(scene, &plhs[0], options, timing);
+    }
+    
+    if (timing) {
+        plhs[1] = mexximp::timing_report_struct(report);
+    }
+}
+
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 {
-    if (nrhs < 1 || !mxIsChar(prhs[0])) {
+    mexAtExit(clearAll);
+    
+    if (nrhs < 1 || !(mxIsChar(prhs[0]) || mxIsCell(prhs[0]) || mxIsUint8(prhs[0]))) {
         printUsage();
         plhs[0] = mexximp::emptyDouble();
         return;
     }
     
-    int postprocessFlags = 0;
-    if (1 < nrhs && mxIsStruct(prhs[1])) {
-        postprocessFlags = mexximp::postprocess_step_codes(prhs[1]);
+    if (mxIsUint8(prhs[0])) {
+        importMemory(nlhs, plhs, nrhs, prhs);
+        return;
+    }
+    
+    if (mxIsCell(prhs[0])) {
+        unsigned postprocessFlags;
+        mexximp::import_options options;
+        readImportArgs(nrhs, prhs, 1, &postprocessFlags, &options);
+        importBatch(nlhs, plhs, prhs[0], postprocessFlags, options);
+        return;
     }
     
     char* sceneFile = mxArrayToString(prhs[0]);
     const std::string& pFile(sceneFile);
     mxFree(sceneFile);
     
+    if (0 == pFile.compare("-cache")) {
+        manageCache(nrhs, prhs);
+        plhs[0] = mexximp::cache_info();
+        return;
+    }
+    
+    if (manageJobs(nlhs, plhs, nrhs, prhs, pFile)) {
+        return;
+    }
+    
+    unsigned postprocessFlags;
+    mexximp::import_options options;
+    readImportArgs(nrhs, prhs, 1, &postprocessFlags, &options);
+    
+    mexximp::timing_report report;
+    mexximp::timing_report* timing = 1 < nlhs ? &report : 0;
+    
+    // a cache hit is reported as its own phase, in place of reading and converting
+    mexximp::cache_key key;
+    bool use_cache = options.use_cache && mexximp::make_cache_key(pFile, postprocessFlags, options, &key);
+    if (use_cache) {
+        mexximp::phase_scope cachePhase(timing);
+        const mxArray* cached = mexximp::cache_find(key);
+        if (cached) {
+            plhs[0] = mxDuplicateArray(cached);
+            cachePhase.finish("cache", 1, plhs[0]);
+            if (timing) {
+                plhs[1] = mexximp::timing_report_struct(report);
+            }
+            return;
+        }
+    }
+    
     Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(
-            pFile,
-            postprocessFlags);
+    mexximp::apply_config(&importer, options.config);
+    if (options.memory_map) {
+        mexximp::use_mmap_io(&importer);
+    }
+    const aiScene* scene = readScene(&importer, pFile, postprocessFlags, timing);
     
     if(!scene) {
         mexPrintf("%s\n", importer.GetErrorString());
         mexPrintf("\n");
         plhs[0] = mexximp::emptyDouble();
+        if (timing) {
+            plhs[1] = mexximp::timing_report_struct(report);
+        }
         return;
     }
     
-    if (1 <= nlhs) {
-        mexximp::to_matlab_scene(scene, &plhs[0]);
+    if (1 <= nlhs || use_cache) {
+        mexximp::to_matlab_scene(scene, &plhs[0], options, timing);
+    }
+    
+    if (timing) {
+        plhs[1] = mexximp::timing_report_struct(report);
+    }
+    
+    if (use_cache) {
+        mexximp::cache_insert(key, plhs[0]);
     }
 }
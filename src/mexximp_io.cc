@@ -0,0 +1,223 @@
+// Assimp file access for scenes that don't come from the local disk.
+
+#include "mexximp_io.h"
+
+#include <string.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace mexximp {
+    
+    // memory stream
+    
+    size_t memory_io_stream::Read(void* buffer, size_t size, size_t count) {
+        if (!size || !count || position >= num_bytes) {
+            return 0;
+        }
+        
+        // whole elements only, like fread
+        size_t num_elements = (num_bytes - position) / size;
+        if (num_elements > count) {
+            num_elements = count;
+        }
+        memcpy(buffer, data + position, num_elements * size);
+        position += num_elements * size;
+        return num_elements;
+    }
+    
+    size_t memory_io_stream::Write(const void* /* buffer */, size_t /* size */, size_t /* count */) {
+        return 0;
+    }
+    
+    aiReturn memory_io_stream::Seek(size_t offset, aiOrigin origin) {
+        size_t target;
+        switch (origin) {
+            case aiOrigin_SET:
+                target = offset;
+                break;
+            case aiOrigin_CUR:
+                target = position + offset;
+                break;
+            case aiOrigin_END:
+                // offset counts back from the end
+                if (offset > num_bytes) {
+                    return aiReturn_FAILURE;
+                }
+                target = num_bytes - offset;
+                break;
+            default:
+                return aiReturn_FAILURE;
+        }
+        
+        if (target > num_bytes) {
+            return aiReturn_FAILURE;
+        }
+        position = target;
+        return aiReturn_SUCCESS;
+    }
+    
+    size_t memory_io_stream::Tell() const {
+        return position;
+    }
+    
+    size_t memory_io_stream::FileSize() const {
+        return num_bytes;
+    }
+    
+    void memory_io_stream::Flush() {
+    }
+    
+    // memory file system
+    
+    std::string base_name(const std::string& name) {
+        size_t separator = name.find_last_of("/\\");
+        if (std::string::npos == separator) {
+            return name;
+        }
+        return name.substr(separator + 1);
+    }
+    
+    void memory_io_system::add_file(const std::string& name, const void* data, size_t num_bytes) {
+        memory_file file;
+        file.data = (const char*)data;
+        file.num_bytes = num_bytes;
+        files[name] = file;
+    }
+    
+    const memory_io_system::memory_file* memory_io_system::find_file(const char* name) const {
+        if (!name) {
+            return 0;
+        }
+        
+        std::map<std::string, memory_file>::const_iterator found = files.find(name);
+        if (found != files.end()) {
+            return &found->second;
+        }
+        
+        // importers prefix side files with the main file's folder, like "./" or "/"
+        std::string base = base_name(name);
+        for (found = files.begin(); found != files.end(); ++found) {
+            if (base_name(found->first) == base) {
+                return &found->second;
+            }
+        }
+        return 0;
+    }
+    
+    bool memory_io_system::Exists(const char* name) const {
+        return 0 != find_file(name);
+    }
+    
+    char memory_io_system::getOsSeparator() const {
+        return '/';
+    }
+    
+    Assimp::IOStream* memory_io_system::Open(const char* name, const char* mode) {
+        if (mode && (strchr(mode, 'w') || strchr(mode, 'a'))) {
+            return 0;
+        }
+        
+        const memory_file* file = find_file(name);
+        if (!file) {
+            return 0;
+        }
+        return new memory_io_stream(file->data, file->num_bytes);
+    }
+    
+    void memory_io_system::Close(Assimp::IOStream* stream) {
+        delete stream;
+    }
+    
+    // mmap file system
+    
+#ifndef _WIN32
+    
+    mmap_io_stream::~mmap_io_stream() {
+        if (num_bytes) {
+            munmap((void*)data, num_bytes);
+        }
+    }
+    
+    bool mmap_io_system::Exists(const char* name) const {
+        struct stat file_stat;
+        return name && 0 == stat(name, &file_stat);
+    }
+    
+    char mmap_io_system::getOsSeparator() const {
+        return '/';
+    }
+    
+    Assimp::IOStream* mmap_io_system::Open(const char* name, const char* mode) {
+        if (!name || (mode && (strchr(mode, 'w') || strchr(mode, 'a')))) {
+            return 0;
+        }
+        
+        int file = open(name, O_RDONLY);
+        if (0 > file) {
+            return 0;
+        }
+        
+        struct stat file_stat;
+        if (0 != fstat(file, &file_stat) || !S_ISREG(file_stat.st_mode)) {
+            close(file);
+            return 0;
+        }
+        
+        // empty files can't be mapped, but they can be read
+        size_t num_bytes = file_stat.st_size;
+        if (!num_bytes) {
+            close(file);
+            return new memory_io_stream("", 0);
+        }
+        
+        // shared mappings let other processes reuse the same cached pages
+        void* mapping = mmap(0, num_bytes, PROT_READ, MAP_SHARED, file, 0);
+        close(file);
+        if (MAP_FAILED == mapping) {
+            return 0;
+        }
+        madvise(mapping, num_bytes, MADV_SEQUENTIAL);
+        
+        return new mmap_io_stream((const char*)mapping, num_bytes);
+    }
+    
+    void mmap_io_system::Close(Assimp::IOStream* stream) {
+        delete stream;
+    }
+    
+    void use_mmap_io(Assimp::Importer* importer) {
+        importer->SetIOHandler(new mmap_io_system());
+    }
+    
+#else
+    
+    // no mmap, keep Assimp's default IOSystem
+    mmap_io_stream::~mmap_io_stream() {
+    }
+    
+    bool mmap_io_system::Exists(const char* /* name */) const {
+        return false;
+    }
+    
+    char mmap_io_system::getOsSeparator() const {
+        return '\\';
+    }
+    
+    Assimp::IOStream* mmap_io_system::Open(const char* /* name */, const char* /* mode */) {
+        return 0;
+    }
+    
+    void mmap_io_system::Close(Assimp::IOStream* stream) {
+        delete stream;
+    }
+    
+    void use_mmap_io(Assimp::Importer* /* importer */) {
+    }
+    
+#endif
+}
@@ -0,0 +1,78 @@
+/** Assimp file access for scenes that don't come from the local disk.
+ *
+ *  Assimp reads every file through an IOSystem, which the Importer owns
+ *  and deletes.  The memory IOSystem serves named byte buffers instead, so
+ *  multi-file formats can find their side files, like .mtl or textures.
+ *  Buffers are borrowed and must outlive the import.
+ *
+ *  The mmap IOSystem reads local files straight from the page cache,
+ *  instead of through many small stdio reads.
+ */
+
+#ifndef MEXXIMP_IO_H_
+#define MEXXIMP_IO_H_
+
+#include <stddef.h>
+#include <map>
+#include <string>
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+#include <assimp/Importer.hpp>
+
+namespace mexximp {
+    
+    // read-only stream over a borrowed buffer
+    struct memory_io_stream : public Assimp::IOStream {
+        const char* data;
+        size_t num_bytes;
+        size_t position;
+        
+        memory_io_stream(const char* buffer, size_t buffer_bytes) : data(buffer), num_bytes(buffer_bytes), position(0) {}
+        
+        size_t Read(void* buffer, size_t size, size_t count);
+        size_t Write(const void* buffer, size_t size, size_t count);
+        aiReturn Seek(size_t offset, aiOrigin origin);
+        size_t Tell() const;
+        size_t FileSize() const;
+        void Flush();
+    };
+    
+    // named buffers, found by name or by base name, since importers look for side files next to the main file
+    struct memory_io_system : public Assimp::IOSystem {
+        struct memory_file {
+            const char* data;
+            size_t num_bytes;
+        };
+        std::map<std::string, memory_file> files;
+        
+        void add_file(const std::string& name, const void* data, size_t num_bytes);
+        const memory_file* find_file(const char* name) const;
+        
+        bool Exists(const char* name) const;
+        char getOsSeparator() const;
+        Assimp::IOStream* Open(const char* name, const char* mode);
+        void Close(Assimp::IOStream* stream);
+    };
+    
+    // read-only stream over a whole file mapped into memory, unmapped when closed
+    struct mmap_io_stream : public memory_io_stream {
+        mmap_io_stream(const char* mapping, size_t mapping_bytes) : memory_io_stream(mapping, mapping_bytes) {}
+        ~mmap_io_stream();
+    };
+    
+    // local files, opened read-only and mapped with a hint for sequential reading
+    struct mmap_io_system : public Assimp::IOSystem {
+        bool Exists(const char* name) const;
+        char getOsSeparator() const;
+        Assimp::IOStream* Open(const char* name, const char* mode);
+        void Close(Assimp::IOStream* stream);
+    };
+    
+    // have an importer read through mmap_io_system, where mmap is available
+    void use_mmap_io(Assimp::Importer* importer);
+    
+    // file name with any directory removed
+    std::string base_name(const std::string& name);
+}
+
+#endif  // MEXXIMP_IO_H_
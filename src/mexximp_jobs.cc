@@ -0,0 +1,283 @@
+// Background import jobs.
+
+#include "mexximp_jobs.h"
+#include "mexximp_cache.h"
+#include "mexximp_constants.h"
+#include "mexximp_io.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <mex.h>
+#include <assimp/Importer.hpp>
+#include <assimp/ProgressHandler.hpp>
+
+namespace mexximp {
+    
+    struct import_job {
+        std::string file;
+        unsigned postprocess_flags;
+        import_options options;
+        cache_key key;
+        bool use_cache;
+        
+        // scene from the cache, already converted and persistent
+        mxArray* cached_scene;
+        
+        std::thread thread;
+        std::atomic<bool> cancelled;
+        std::atomic<float> progress;
+        
+        // guarded by mutex until finished
+        std::mutex mutex;
+        std::condition_variable finished_condition;
+        bool finished;
+        aiScene* scene;
+        std::string error;
+        
+        import_job() : postprocess_flags(0), use_cache(false), cached_scene(0), cancelled(false), progress(0), finished(false), scene(0) {}
+        ~import_job() {
+            delete scene;
+            if (cached_scene) {
+                mxDestroyArray(cached_scene);
+            }
+        }
+    };
+    
+    typedef std::shared_ptr<import_job> job_pointer;
+    
+    // Assimp reports file reading and postprocessing as one fraction, and stops when we return false
+    // the Importer owns and deletes this handler
+    struct job_progress : public Assimp::ProgressHandler {
+        import_job* job;
+        
+        job_progress(import_job* progress_job) : job(progress_job) {}
+        bool Update(float percentage) {
+            if (0 <= percentage) {
+                job->progress = percentage;
+            }
+            return !job->cancelled;
+        }
+    };
+    
+    static void run_job(job_pointer job) {
+        aiScene* scene = 0;
+        std::string error;
+        try {
+            Assimp::Importer importer;
+            apply_config(&importer, job->options.config);
+            importer.SetProgressHandler(new job_progress(job.get()));
+            if (job->options.memory_map) {
+                use_mmap_io(&importer);
+            }
+            if (importer.ReadFile(job->file, job->postprocess_flags)) {
+                scene = importer.GetOrphanedScene();
+            } else {
+                error = importer.GetErrorString();
+            }
+        } catch (const std::exception& e) {
+            error = e.what();
+        } catch (...) {
+            error = "Unknown error while reading scene file.";
+        }
+        
+        if (job->cancelled) {
+            delete scene;
+            scene = 0;
+            error = "Import was cancelled.";
+        }
+        
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->scene = scene;
+        job->error = error;
+        job->progress = 1;
+        job->finished = true;
+        job->finished_condition.notify_all();
+    }
+    
+    static std::map<unsigned, job_pointer> jobs;
+    static unsigned next_job_id = 1;
+    
+    // cancelled jobs whose threads may still be reading, joined once they finish
+    static std::vector<job_pointer> cancelled_jobs;
+    static bool is_locked = false;
+    
+    static bool is_finished(const job_pointer& job) {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        return job->finished;
+    }
+    
+    static void forget_finished_jobs() {
+        for (size_t i = 0; i < cancelled_jobs.size();) {
+            if (is_finished(cancelled_jobs[i])) {
+                cancelled_jobs[i]->thread.join();
+                cancelled_jobs.erase(cancelled_jobs.begin() + i);
+            } else {
+                i++;
+            }
+        }
+        
+        if (jobs.empty() && cancelled_jobs.empty() && is_locked) {
+            mexUnlock();
+            is_locked = false;
+        }
+    }
+    
+    static job_pointer find_job(unsigned job_id) {
+        std::map<unsigned, job_pointer>::iterator found = jobs.find(job_id);
+        if (found == jobs.end()) {
+            return job_pointer();
+        }
+        return found->second;
+    }
+    
+    unsigned job_start(const std::string& file, unsigned postprocess_flags, const import_options& options) {
+        job_pointer job(new import_job());
+        job->file = file;
+        job->postprocess_flags = postprocess_flags;
+        job->options = options;
+        job->use_cache = options.use_cache && make_cache_key(file, postprocess_flags, options, &job->key);
+        
+        const mxArray* cached = job->use_cache ? cache_find(job->key) : 0;
+        if (cached) {
+            job->cached_scene = mxDuplicateArray(cached);
+            mexMakeArrayPersistent(job->cached_scene);
+            job->progress = 1;
+            job->finished = true;
+        } else {
+            job->thread = std::thread(run_job, job);
+        }
+        
+        unsigned job_id = next_job_id++;
+        jobs[job_id] = job;
+        
+        if (!is_locked) {
+            mexLock();
+            is_locked = true;
+        }
+        
+        forget_finished_jobs();
+        return job_id;
+    }
+    
+    static const char* job_info_field_names[] = {
+        "id",
+        "file",
+        "state",
+        "progress",
+        "error",
+    };
+    
+    mxArray* job_info(unsigned job_id) {
+        forget_finished_jobs();
+        
+        job_pointer job = find_job(job_id);
+        if (!job) {
+            return 0;
+        }
+        
+        const char* state = "running";
+        std::string error;
+        {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            if (job->finished) {
+                state = (job->scene || job->cached_scene) ? "finished" : "failed";
+                error = job->error;
+            }
+        }
+        
+        mxArray* info = mxCreateStructMatrix(1, 1, COUNT(job_info_field_names), job_info_field_names);
+        mxSetField(info, 0, "id", mxCreateDoubleScalar(job_id));
+        mxSetField(info, 0, "file", mxCreateString(job->file.c_str()));
+        mxSetField(info, 0, "state", mxCreateString(state));
+        mxSetField(info, 0, "progress", mxCreateDoubleScalar(job->progress));
+        mxSetField(info, 0, "error", mxCreateString(error.c_str()));
+        return info;
+    }
+    
+    bool job_wait(unsigned job_id, double timeout_seconds) {
+        job_pointer job = find_job(job_id);
+        if (!job) {
+            return false;
+        }
+        
+        std::unique_lock<std::mutex> lock(job->mutex);
+        if (0 > timeout_seconds) {
+            job->finished_condition.wait(lock, [&]() { return job->finished; });
+            return true;
+        }
+        return job->finished_condition.wait_for(lock, std::chrono::duration<double>(timeout_seconds), [&]() { return job->finished; });
+    }
+    
+    bool job_cancel(unsigned job_id) {
+        job_pointer job = find_job(job_id);
+        if (!job) {
+            return false;
+        }
+        
+        // don't wait here, the thread is joined once it notices
+        job->cancelled = true;
+        jobs.erase(job_id);
+        if (job->thread.joinable()) {
+            cancelled_jobs.push_back(job);
+        }
+        
+        forget_finished_jobs();
+        return true;
+    }
+    
+    mxArray* job_fetch(unsigned job_id, std::string* error) {
+        job_pointer job = find_job(job_id);
+        if (!job) {
+            if (error) {
+                *error = "No such import job.";
+            }
+            return 0;
+        }
+        
+        job_wait(job_id, -1);
+        if (job->thread.joinable()) {
+            job->thread.join();
+        }
+        jobs.erase(job_id);
+        
+        // conversion uses the mx API, so it happens here on the Matlab thread
+        mxArray* matlab_scene = 0;
+        if (job->cached_scene) {
+            matlab_scene = mxDuplicateArray(job->cached_scene);
+        } else if (job->scene) {
+            to_matlab_scene(job->scene, &matlab_scene, job->options);
+            if (job->use_cache) {
+                cache_insert(job->key, matlab_scene);
+            }
+        } else if (error) {
+            *error = job->error;
+        }
+        
+        forget_finished_jobs();
+        return matlab_scene;
+    }
+    
+    void jobs_clear() {
+        for (std::map<unsigned, job_pointer>::iterator job = jobs.begin(); job != jobs.end(); ++job) {
+            job->second->cancelled = true;
+            if (job->second->thread.joinable()) {
+                cancelled_jobs.push_back(job->second);
+            }
+        }
+        jobs.clear();
+        
+        for (size_t i = 0; i < cancelled_jobs.size(); i++) {
+            cancelled_jobs[i]->thread.join();
+        }
+        cancelled_jobs.clear();
+        
+        forget_finished_jobs();
+    }
+}
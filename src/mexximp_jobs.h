@@ -0,0 +1,42 @@
+/** Background import jobs.
+ *
+ *  Each job parses and postprocesses one scene file with its own
+ *  Assimp::Importer on its own thread.  Only the parsed aiScene is shared,
+ *  the Matlab scene is converted on the Matlab thread when the job is
+ *  fetched.  While any jobs exist, the mex-function that owns them stays
+ *  locked with mexLock, and it should call jobs_clear from its mexAtExit
+ *  function.
+ *
+ *  Apart from the job threads themselves, these functions use the mx API,
+ *  so only call them on the Matlab thread.
+ */
+
+#ifndef MEXXIMP_JOBS_H_
+#define MEXXIMP_JOBS_H_
+
+#include <string>
+#include <matrix.h>
+#include "mexximp_scene.h"
+
+namespace mexximp {
+    
+    // start reading a scene file in the background, returns a job id
+    unsigned job_start(const std::string& file, unsigned postprocess_flags, const import_options& options);
+    
+    // struct with the job state, progress, and any error, or 0 for an unknown job
+    mxArray* job_info(unsigned job_id);
+    
+    // true if the job is finished within timeout_seconds, negative waits as long as it takes
+    bool job_wait(unsigned job_id, double timeout_seconds);
+    
+    // stop reading as soon as Assimp allows, then forget the job -- false for an unknown job
+    bool job_cancel(unsigned job_id);
+    
+    // wait for the job, convert its scene to Matlab, then forget the job -- 0 if the job failed
+    mxArray* job_fetch(unsigned job_id, std::string* error);
+    
+    // cancel and forget all jobs
+    void jobs_clear();
+}
+
+#endif  // MEXXIMP_JOBS_H_
@@ -0,0 +1,343 @@
+// Bulk numeric kernels with SIMD versions chosen at runtime.
+
+#include "mexximp_kernels.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MEXXIMP_X86_KERNELS
+#define MEXXIMP_TARGET_AVX2 __attribute__((target("avx2")))
+#define MEXXIMP_TARGET_SSE2 __attribute__((target("sse2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define MEXXIMP_X86_KERNELS
+#define MEXXIMP_TARGET_AVX2
+#define MEXXIMP_TARGET_SSE2
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace mexximp {
+
+    // scalar versions work everywhere, and finish the tails of SIMD versions
+
+    static void widen_floats_scalar(const float* source, double* target, size_t num_elements) {
+        for (size_t i = 0; i < num_elements; i++) {
+            target[i] = source[i];
+        }
+    }
+
+    static void narrow_doubles_scalar(const double* source, float* target, size_t num_elements) {
+        for (size_t i = 0; i < num_elements; i++) {
+            target[i] = (float)source[i];
+        }
+    }
+
+    static inline uint32_t swap_red_blue_texel(uint32_t texel) {
+        return (texel & 0xFF00FF00) | ((texel >> 16) & 0x000000FF) | ((texel & 0x000000FF) << 16);
+    }
+
+    static void swap_red_blue_scalar(const unsigned char* source, unsigned char* target, size_t num_texels) {
+        for (size_t i = 0; i < num_texels; i++) {
+            uint32_t texel;
+            memcpy(&texel, &source[4 * i], 4);
+            texel = swap_red_blue_texel(texel);
+            memcpy(&target[4 * i], &texel, 4);
+        }
+    }
+
+    template <typename T>
+    static void bound_xyz_scalar(const T* xyz, size_t num_vectors, T* mins, T* maxes) {
+        for (size_t i = 0; i < num_vectors; i++) {
+            for (unsigned c = 0; c < 3; c++) {
+                T value = xyz[3 * i + c];
+                mins[c] = value < mins[c] ? value : mins[c];
+                maxes[c] = value > maxes[c] ? value : maxes[c];
+            }
+        }
+    }
+    
+    // SIMD bounds load 3 registers at a time, so lane j of register r always holds component (r * lanes + j) % 3
+    template <typename T>
+    static void bound_xyz_lanes(const T* lane_mins, const T* lane_maxes, unsigned lanes, T* mins, T* maxes) {
+        for (unsigned j = 0; j < 3 * lanes; j++) {
+            unsigned c = j % 3;
+            mins[c] = lane_mins[j] < mins[c] ? lane_mins[j] : mins[c];
+            maxes[c] = lane_maxes[j] > maxes[c] ? lane_maxes[j] : maxes[c];
+        }
+    }
+    
+#ifdef MEXXIMP_X86_KERNELS
+
+    // SSE2 versions, 4 elements at a time
+
+    MEXXIMP_TARGET_SSE2
+    static void widen_floats_sse2(const float* source, double* target, size_t num_elements) {
+        size_t i = 0;
+        for (; i + 4 <= num_elements; i += 4) {
+            __m128 floats = _mm_loadu_ps(&source[i]);
+            _mm_storeu_pd(&target[i], _mm_cvtps_pd(floats));
+            _mm_storeu_pd(&target[i + 2], _mm_cvtps_pd(_mm_movehl_ps(floats, floats)));
+        }
+        widen_floats_scalar(&source[i], &target[i], num_elements - i);
+    }
+
+    MEXXIMP_TARGET_SSE2
+    static void narrow_doubles_sse2(const double* source, float* target, size_t num_elements) {
+        size_t i = 0;
+        for (; i + 4 <= num_elements; i += 4) {
+            __m128 low = _mm_cvtpd_ps(_mm_loadu_pd(&source[i]));
+            __m128 high = _mm_cvtpd_ps(_mm_loadu_pd(&source[i + 2]));
+            _mm_storeu_ps(&target[i], _mm_movelh_ps(low, high));
+        }
+        narrow_doubles_scalar(&source[i], &target[i], num_elements - i);
+    }
+
+    MEXXIMP_TARGET_SSE2
+    static void swap_red_blue_sse2(const unsigned char* source, unsigned char* target, size_t num_texels) {
+        const __m128i green_alpha = _mm_set1_epi32(0xFF00FF00);
+        const __m128i low_byte = _mm_set1_epi32(0x000000FF);
+        size_t i = 0;
+        for (; i + 4 <= num_texels; i += 4) {
+            __m128i texels = _mm_loadu_si128((const __m128i*)&source[4 * i]);
+            __m128i swapped = _mm_or_si128(
+                    _mm_and_si128(texels, green_alpha),
+                    _mm_or_si128(
+                    _mm_and_si128(_mm_srli_epi32(texels, 16), low_byte),
+                    _mm_slli_epi32(_mm_and_si128(texels, low_byte), 16)));
+            _mm_storeu_si128((__m128i*)&target[4 * i], swapped);
+        }
+        swap_red_blue_scalar(&source[4 * i], &target[4 * i], num_texels - i);
+    }
+
+    MEXXIMP_TARGET_SSE2
+    static void bound_xyz_floats_sse2(const float* xyz, size_t num_vectors, float* mins, float* maxes) {
+        size_t i = 0;
+        if (num_vectors >= 4) {
+            __m128 min0 = _mm_loadu_ps(&xyz[0]), max0 = min0;
+            __m128 min1 = _mm_loadu_ps(&xyz[4]), max1 = min1;
+            __m128 min2 = _mm_loadu_ps(&xyz[8]), max2 = min2;
+            for (i = 4; i + 4 <= num_vectors; i += 4) {
+                __m128 v0 = _mm_loadu_ps(&xyz[3 * i]);
+                __m128 v1 = _mm_loadu_ps(&xyz[3 * i + 4]);
+                __m128 v2 = _mm_loadu_ps(&xyz[3 * i + 8]);
+                min0 = _mm_min_ps(min0, v0); max0 = _mm_max_ps(max0, v0);
+                min1 = _mm_min_ps(min1, v1); max1 = _mm_max_ps(max1, v1);
+                min2 = _mm_min_ps(min2, v2); max2 = _mm_max_ps(max2, v2);
+            }
+            float lane_mins[12], lane_maxes[12];
+            _mm_storeu_ps(&lane_mins[0], min0); _mm_storeu_ps(&lane_maxes[0], max0);
+            _mm_storeu_ps(&lane_mins[4], min1); _mm_storeu_ps(&lane_maxes[4], max1);
+            _mm_storeu_ps(&lane_mins[8], min2); _mm_storeu_ps(&lane_maxes[8], max2);
+            bound_xyz_lanes(lane_mins, lane_maxes, 4, mins, maxes);
+        }
+        bound_xyz_scalar(&xyz[3 * i], num_vectors - i, mins, maxes);
+    }
+    
+    MEXXIMP_TARGET_SSE2
+    static void bound_xyz_doubles_sse2(const double* xyz, size_t num_vectors, double* mins, double* maxes) {
+        size_t i = 0;
+        if (num_vectors >= 2) {
+            __m128d min0 = _mm_loadu_pd(&xyz[0]), max0 = min0;
+            __m128d min1 = _mm_loadu_pd(&xyz[2]), max1 = min1;
+            __m128d min2 = _mm_loadu_pd(&xyz[4]), max2 = min2;
+            for (i = 2; i + 2 <= num_vectors; i += 2) {
+                __m128d v0 = _mm_loadu_pd(&xyz[3 * i]);
+                __m128d v1 = _mm_loadu_pd(&xyz[3 * i + 2]);
+                __m128d v2 = _mm_loadu_pd(&xyz[3 * i + 4]);
+                min0 = _mm_min_pd(min0, v0); max0 = _mm_max_pd(max0, v0);
+                min1 = _mm_min_pd(min1, v1); max1 = _mm_max_pd(max1, v1);
+                min2 = _mm_min_pd(min2, v2); max2 = _mm_max_pd(max2, v2);
+            }
+            double lane_mins[6], lane_maxes[6];
+            _mm_storeu_pd(&lane_mins[0], min0); _mm_storeu_pd(&lane_maxes[0], max0);
+            _mm_storeu_pd(&lane_mins[2], min1); _mm_storeu_pd(&lane_maxes[2], max1);
+            _mm_storeu_pd(&lane_mins[4], min2); _mm_storeu_pd(&lane_maxes[4], max2);
+            bound_xyz_lanes(lane_mins, lane_maxes, 2, mins, maxes);
+        }
+        bound_xyz_scalar(&xyz[3 * i], num_vectors - i, mins, maxes);
+    }
+    
+    // AVX2 versions, 8 elements at a time
+
+    MEXXIMP_TARGET_AVX2
+    static void widen_floats_avx2(const float* source, double* target, size_t num_elements) {
+        size_t i = 0;
+        for (; i + 8 <= num_elements; i += 8) {
+            _mm256_storeu_pd(&target[i], _mm256_cvtps_pd(_mm_loadu_ps(&source[i])));
+            _mm256_storeu_pd(&target[i + 4], _mm256_cvtps_pd(_mm_loadu_ps(&source[i + 4])));
+        }
+        widen_floats_scalar(&source[i], &target[i], num_elements - i);
+    }
+
+    MEXXIMP_TARGET_AVX2
+    static void narrow_doubles_avx2(const double* source, float* target, size_t num_elements) {
+        size_t i = 0;
+        for (; i + 8 <= num_elements; i += 8) {
+            _mm_storeu_ps(&target[i], _mm256_cvtpd_ps(_mm256_loadu_pd(&source[i])));
+            _mm_storeu_ps(&target[i + 4], _mm256_cvtpd_ps(_mm256_loadu_pd(&source[i + 4])));
+        }
+        narrow_doubles_scalar(&source[i], &target[i], num_elements - i);
+    }
+
+    MEXXIMP_TARGET_AVX2
+    static void swap_red_blue_avx2(const unsigned char* source, unsigned char* target, size_t num_texels) {
+        const __m256i swap_bytes = _mm256_setr_epi8(
+                2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+        size_t i = 0;
+        for (; i + 8 <= num_texels; i += 8) {
+            __m256i texels = _mm256_loadu_si256((const __m256i*)&source[4 * i]);
+            _mm256_storeu_si256((__m256i*)&target[4 * i], _mm256_shuffle_epi8(texels, swap_bytes));
+        }
+        swap_red_blue_scalar(&source[4 * i], &target[4 * i], num_texels - i);
+    }
+
+    MEXXIMP_TARGET_AVX2
+    static void bound_xyz_floats_avx2(const float* xyz, size_t num_vectors, float* mins, float* maxes) {
+        size_t i = 0;
+        if (num_vectors >= 8) {
+            __m256 min0 = _mm256_loadu_ps(&xyz[0]), max0 = min0;
+            __m256 min1 = _mm256_loadu_ps(&xyz[8]), max1 = min1;
+            __m256 min2 = _mm256_loadu_ps(&xyz[16]), max2 = min2;
+            for (i = 8; i + 8 <= num_vectors; i += 8) {
+                __m256 v0 = _mm256_loadu_ps(&xyz[3 * i]);
+                __m256 v1 = _mm256_loadu_ps(&xyz[3 * i + 8]);
+                __m256 v2 = _mm256_loadu_ps(&xyz[3 * i + 16]);
+                min0 = _mm256_min_ps(min0, v0); max0 = _mm256_max_ps(max0, v0);
+                min1 = _mm256_min_ps(min1, v1); max1 = _mm256_max_ps(max1, v1);
+                min2 = _mm256_min_ps(min2, v2); max2 = _mm256_max_ps(max2, v2);
+            }
+            float lane_mins[24], lane_maxes[24];
+            _mm256_storeu_ps(&lane_mins[0], min0); _mm256_storeu_ps(&lane_maxes[0], max0);
+            _mm256_storeu_ps(&lane_mins[8], min1); _mm256_storeu_ps(&lane_maxes[8], max1);
+            _mm256_storeu_ps(&lane_mins[16], min2); _mm256_storeu_ps(&lane_maxes[16], max2);
+            bound_xyz_lanes(lane_mins, lane_maxes, 8, mins, maxes);
+        }
+        bound_xyz_scalar(&xyz[3 * i], num_vectors - i, mins, maxes);
+    }
+    
+    MEXXIMP_TARGET_AVX2
+    static void bound_xyz_doubles_avx2(const double* xyz, size_t num_vectors, double* mins, double* maxes) {
+        size_t i = 0;
+        if (num_vectors >= 4) {
+            __m256d min0 = _mm256_loadu_pd(&xyz[0]), max0 = min0;
+            __m256d min1 = _mm256_loadu_pd(&xyz[4]), max1 = min1;
+            __m256d min2 = _mm256_loadu_pd(&xyz[8]), max2 = min2;
+            for (i = 4; i + 4 <= num_vectors; i += 4) {
+                __m256d v0 = _mm256_loadu_pd(&xyz[3 * i]);
+                __m256d v1 = _mm256_loadu_pd(&xyz[3 * i + 4]);
+                __m256d v2 = _mm256_loadu_pd(&xyz[3 * i + 8]);
+                min0 = _mm256_min_pd(min0, v0); max0 = _mm256_max_pd(max0, v0);
+                min1 = _mm256_min_pd(min1, v1); max1 = _mm256_max_pd(max1, v1);
+                min2 = _mm256_min_pd(min2, v2); max2 = _mm256_max_pd(max2, v2);
+            }
+            double lane_mins[12], lane_maxes[12];
+            _mm256_storeu_pd(&lane_mins[0], min0); _mm256_storeu_pd(&lane_maxes[0], max0);
+            _mm256_storeu_pd(&lane_mins[4], min1); _mm256_storeu_pd(&lane_maxes[4], max1);
+            _mm256_storeu_pd(&lane_mins[8], min2); _mm256_storeu_pd(&lane_maxes[8], max2);
+            bound_xyz_lanes(lane_mins, lane_maxes, 4, mins, maxes);
+        }
+        bound_xyz_scalar(&xyz[3 * i], num_vectors - i, mins, maxes);
+    }
+    
+    static bool cpu_has_avx2() {
+#if defined(__GNUC__)
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#else
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) {
+            return false;
+        }
+
+        // OS must save AVX registers, as well as CPU support AVX2
+        __cpuid(info, 1);
+        bool os_saves_avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28))
+                && 6 == (_xgetbv(0) & 6);
+        __cpuidex(info, 7, 0);
+        return os_saves_avx && (info[1] & (1 << 5));
+#endif
+    }
+
+#endif
+
+    // choose kernels once, the first time any is called
+
+    struct kernel_table {
+        void (*widen_floats)(const float*, double*, size_t);
+        void (*narrow_doubles)(const double*, float*, size_t);
+        void (*swap_red_blue)(const unsigned char*, unsigned char*, size_t);
+        void (*bound_xyz_floats)(const float*, size_t, float*, float*);
+        void (*bound_xyz_doubles)(const double*, size_t, double*, double*);
+        const char* version;
+    };
+
+    static kernel_table choose_kernels() {
+        kernel_table kernels;
+#ifdef MEXXIMP_X86_KERNELS
+        if (cpu_has_avx2()) {
+            kernels.widen_floats = widen_floats_avx2;
+            kernels.narrow_doubles = narrow_doubles_avx2;
+            kernels.swap_red_blue = swap_red_blue_avx2;
+            kernels.bound_xyz_floats = bound_xyz_floats_avx2;
+            kernels.bound_xyz_doubles = bound_xyz_doubles_avx2;
+            kernels.version = "avx2";
+        } else {
+            // every x86 CPU that can run Matlab has SSE2
+            kernels.widen_floats = widen_floats_sse2;
+            kernels.narrow_doubles = narrow_doubles_sse2;
+            kernels.swap_red_blue = swap_red_blue_sse2;
+            kernels.bound_xyz_floats = bound_xyz_floats_sse2;
+            kernels.bound_xyz_doubles = bound_xyz_doubles_sse2;
+            kernels.version = "sse2";
+        }
+#else
+        kernels.widen_floats = widen_floats_scalar;
+        kernels.narrow_doubles = narrow_doubles_scalar;
+        kernels.swap_red_blue = swap_red_blue_scalar;
+        kernels.bound_xyz_floats = bound_xyz_scalar<float>;
+        kernels.bound_xyz_doubles = bound_xyz_scalar<double>;
+        kernels.version = "scalar";
+#endif
+        return kernels;
+    }
+
+    static const kernel_table& kernels() {
+        static const kernel_table chosen = choose_kernels();
+        return chosen;
+    }
+
+    void widen_floats(const float* source, double* target, size_t num_elements) {
+        kernels().widen_floats(source, target, num_elements);
+    }
+
+    void narrow_doubles(const double* source, float* target, size_t num_elements) {
+        kernels().narrow_doubles(source, target, num_elements);
+    }
+
+    void swap_red_blue(const unsigned char* source, unsigned char* target, size_t num_texels) {
+        kernels().swap_red_blue(source, target, num_texels);
+    }
+
+    // start from the first vector so every kernel can just shrink and grow
+    void bound_xyz(const float* xyz, size_t num_vectors, float* mins, float* maxes) {
+        for (unsigned c = 0; c < 3; c++) {
+            mins[c] = maxes[c] = xyz[c];
+        }
+        kernels().bound_xyz_floats(xyz, num_vectors, mins, maxes);
+    }
+    
+    void bound_xyz(const double* xyz, size_t num_vectors, double* mins, double* maxes) {
+        for (unsigned c = 0; c < 3; c++) {
+            mins[c] = maxes[c] = xyz[c];
+        }
+        kernels().bound_xyz_doubles(xyz, num_vectors, mins, maxes);
+    }
+    
+    const char* kernel_version() {
+        return kernels().version;
+    }
+}
@@ -0,0 +1,34 @@
+/** Bulk numeric kernels for Assimp <-> Matlab array conversions.
+ *
+ *  Assimp vectors, colors, and matrices are packed floats whose memory
+ *  order already matches the Matlab column-major layouts that mexximp uses.
+ *  So most conversions are bulk widening or narrowing between float and
+ *  double.  Each kernel has SSE2 and AVX2 versions, and a scalar fallback.
+ *  The best version for the current CPU is chosen once, at runtime.
+ */
+
+#ifndef MEXXIMP_KERNELS_H_
+#define MEXXIMP_KERNELS_H_
+
+#include <stddef.h>
+
+namespace mexximp {
+
+    // float -> double, for Assimp -> Matlab
+    void widen_floats(const float* source, double* target, size_t num_elements);
+
+    // double -> float, for Matlab -> Assimp
+    void narrow_doubles(const double* source, float* target, size_t num_elements);
+
+    // swap red and blue bytes, for Assimp BGRA texels <-> Matlab RGBA
+    void swap_red_blue(const unsigned char* source, unsigned char* target, size_t num_texels);
+
+    // min and max of each component of packed xyz vectors, num_vectors must be at least 1
+    void bound_xyz(const float* xyz, size_t num_vectors, float* mins, float* maxes);
+    void bound_xyz(const double* xyz, size_t num_vectors, double* mins, double* maxes);
+    
+    // which kernel version is in use: "avx2", "sse2", or "scalar"
+    const char* kernel_version();
+}
+
+#endif  // MEXXIMP_KERNELS_H_
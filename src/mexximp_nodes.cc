@@ -0,0 +1,524 @@
+// Walk a Matlab node hierarchy once, for utilities like mexximpFlattenNodes.
+
+#include <mex.h>
+#include <string.h>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "mexximp_constants.h"
+#include "mexximp_kernels.h"
+#include "mexximp_util.h"
+
+void printUsage() {
+    mexPrintf("Walk the node hierarchy of a scene:\n");
+    mexPrintf("  [worldTransforms, parents] = mexximpNodes('world', scene)\n");
+    mexPrintf("  rootNode = mexximpNodes('flatten', scene)\n");
+    mexPrintf("  nodeElements = mexximpNodes('paths', scene)\n");
+    mexPrintf("  [sceneBox, nodeBoxes, meshBoxes] = mexximpNodes('bounds', scene, ignoreNodes)\n");
+    mexPrintf("Nodes are visited depth first, parents before children.\n");
+    mexPrintf("worldTransforms(:,:,i) is the accumulated transformation of node i.\n");
+    mexPrintf("parents(i) is the 0-based index of the parent of node i, or -1 for the root.\n");
+    mexPrintf("Boxes are [xmin xmax; ymin ymax; zmin zmax], NaN or [] when there are no vertices.\n");
+    mexPrintf("nodeBoxes(:,:,i) bounds node i and its descendants, in world coordinates.\n");
+    mexPrintf("meshBoxes(:,:,m) bounds scene.meshes(m), in local coordinates.\n");
+    mexPrintf("\n");
+}
+
+// every node in the hierarchy, depth first
+struct node_walk {
+    // struct array holding each node, and index of the node within it
+    std::vector<const mxArray*> arrays;
+    std::vector<unsigned> indices;
+    
+    // 0-based index of each node's parent, 1-based position among its siblings
+    std::vector<int32_T> parents;
+    std::vector<unsigned> child_numbers;
+    
+    // local then world transformations, 16 doubles per node
+    std::vector<double> transforms;
+};
+
+static const double identity[16] = {
+    1, 0, 0, 0,
+    0, 1, 0, 0,
+    0, 0, 1, 0,
+    0, 0, 0, 1,
+};
+
+// walk nested nodes without recursion, to handle deep hierarchies
+static void walk_nested_nodes(const mxArray* root_node, node_walk* walk) {
+    struct pending {
+        const mxArray* array;
+        unsigned index;
+        int32_T parent;
+        unsigned child_number;
+    };
+    
+    pending root = {root_node, 0, -1, 0};
+    std::vector<pending> stack(1, root);
+    while (!stack.empty()) {
+        pending node = stack.back();
+        stack.pop_back();
+        
+        int32_T node_index = walk->arrays.size();
+        walk->arrays.push_back(node.array);
+        walk->indices.push_back(node.index);
+        walk->parents.push_back(node.parent);
+        walk->child_numbers.push_back(node.child_number);
+        
+        const mxArray* transformation = mxGetField(node.array, node.index, "transformation");
+        const double* local = identity;
+        if (transformation && mxIsDouble(transformation) && 16 == mxGetNumberOfElements(transformation)) {
+            local = mxGetPr(transformation);
+        }
+        walk->transforms.insert(walk->transforms.end(), local, local + 16);
+        
+        // push children in reverse so they come off in order
+        const mxArray* children = mxGetField(node.array, node.index, "children");
+        if (!children || !mxIsStruct(children)) {
+            continue;
+        }
+        unsigned num_children = mxGetNumberOfElements(children);
+        for (unsigned c = num_children; c > 0; c--) {
+            pending child = {children, c - 1, node_index, c};
+            stack.push_back(child);
+        }
+    }
+}
+
+// flat nodes from mexximpImport with the flatNodes option
+static bool walk_flat_nodes(const mxArray* root_node, node_walk* walk) {
+    const mxArray* parents = mxGetField(root_node, 0, "parents");
+    const mxArray* transformations = mxGetField(root_node, 0, "transformations");
+    if (!parents || !mxIsInt32(parents)) {
+        return false;
+    }
+    
+    unsigned num_nodes = mxGetNumberOfElements(parents);
+    const int32_T* parents_data = (const int32_T*)mxGetData(parents);
+    for (unsigned i = 0; i < num_nodes; i++) {
+        if ((0 == i && -1 != parents_data[i]) || (0 < i && (0 > parents_data[i] || i <= (unsigned)parents_data[i]))) {
+            return false;
+        }
+    }
+    walk->parents.assign(parents_data, parents_data + num_nodes);
+    
+    if (transformations && mxIsDouble(transformations) && 16 * num_nodes == mxGetNumberOfElements(transformations)) {
+        const double* data = mxGetPr(transformations);
+        walk->transforms.assign(data, data + 16 * num_nodes);
+    } else {
+        for (unsigned i = 0; i < num_nodes; i++) {
+            walk->transforms.insert(walk->transforms.end(), identity, identity + 16);
+        }
+    }
+    return true;
+}
+
+// c = a * b, for column-major 4x4 matrices
+static inline void multiply_4x4(const double* a, const double* b, double* c) {
+    for (unsigned col = 0; col < 4; col++) {
+        for (unsigned row = 0; row < 4; row++) {
+            c[row + 4 * col] = a[row] * b[4 * col]
+                    + a[row + 4] * b[1 + 4 * col]
+                    + a[row + 8] * b[2 + 4 * col]
+                    + a[row + 12] * b[3 + 4 * col];
+        }
+    }
+}
+
+// one pass in walk order, since each parent is already in world coordinates
+static void accumulate_transforms(node_walk* walk) {
+    unsigned num_nodes = walk->parents.size();
+    double* transforms = walk->transforms.data();
+    double world[16];
+    for (unsigned i = 1; i < num_nodes; i++) {
+        multiply_4x4(&transforms[16 * walk->parents[i]], &transforms[16 * i], world);
+        memcpy(&transforms[16 * i], world, sizeof(world));
+    }
+}
+
+static mxArray* world_transforms(const node_walk& walk) {
+    mwSize dims[3] = {4, 4, walk.parents.size()};
+    mxArray* transforms = mxCreateNumericArray(3, &dims[0], mxDOUBLE_CLASS, mxREAL);
+    if (!walk.transforms.empty()) {
+        memcpy(mxGetPr(transforms), walk.transforms.data(), walk.transforms.size() * sizeof(double));
+    }
+    return transforms;
+}
+
+static mxArray* parent_indices(const node_walk& walk) {
+    mxArray* parents = mxCreateNumericMatrix(1, walk.parents.size(), mxINT32_CLASS, mxREAL);
+    if (!walk.parents.empty()) {
+        memcpy(mxGetData(parents), walk.parents.data(), walk.parents.size() * sizeof(int32_T));
+    }
+    return parents;
+}
+
+// copy of each node with its world transformation and no children, as children of a copy of the root
+static mxArray* flatten_nodes(const node_walk& walk) {
+    const mxArray* root_array = walk.arrays[0];
+    unsigned num_fields = mxGetNumberOfFields(root_array);
+    std::vector<const char*> field_names(num_fields);
+    for (unsigned f = 0; f < num_fields; f++) {
+        field_names[f] = mxGetFieldNameByNumber(root_array, f);
+    }
+    
+    unsigned num_nodes = walk.arrays.size();
+    mxArray* root = mxCreateStructMatrix(1, 1, num_fields, field_names.data());
+    mxArray* children = mxCreateStructMatrix(1, num_nodes - 1, num_fields, field_names.data());
+    
+    for (unsigned i = 0; i < num_nodes; i++) {
+        mxArray* target = 0 == i ? root : children;
+        unsigned target_index = 0 == i ? 0 : i - 1;
+        for (unsigned f = 0; f < num_fields; f++) {
+            const char* field_name = field_names[f];
+            if (0 == strcmp("children", field_name) || 0 == strcmp("transformation", field_name)) {
+                continue;
+            }
+            const mxArray* value = mxGetField(walk.arrays[i], walk.indices[i], field_name);
+            if (value) {
+                mxSetField(target, target_index, field_name, mxDuplicateArray(value));
+            }
+        }
+        
+        mxArray* transformation = mxCreateDoubleMatrix(4, 4, mxREAL);
+        memcpy(mxGetPr(transformation), 0 == i ? identity : &walk.transforms[16 * i], 16 * sizeof(double));
+        mxSetField(target, target_index, "transformation", transformation);
+        
+        if (0 < i) {
+            mxSetField(target, target_index, "children", mexximp::emptyDouble());
+        }
+    }
+    
+    mxSetField(root, 0, "children", children);
+    return root;
+}
+
+static const char* node_path_field_names[] = {
+    "name",
+    "path",
+};
+
+// name of each node, and its path like {'rootNode', 'children', 2, 'children', 1}
+static mxArray* node_paths(const node_walk& walk) {
+    unsigned num_nodes = walk.arrays.size();
+    mxArray* node_elements = mxCreateStructMatrix(1, num_nodes, COUNT(node_path_field_names), &node_path_field_names[0]);
+    
+    std::vector<unsigned> depths(num_nodes, 0);
+    for (unsigned i = 0; i < num_nodes; i++) {
+        const mxArray* name = mxGetField(walk.arrays[i], walk.indices[i], "name");
+        mxSetField(node_elements, i, "name", name ? mxDuplicateArray(name) : mexximp::emptyString());
+        
+        // extend the parent's path, which is already done
+        mxArray* path;
+        if (0 == i) {
+            path = mxCreateCellMatrix(1, 1);
+            mxSetCell(path, 0, mxCreateString("rootNode"));
+        } else {
+            unsigned parent = walk.parents[i];
+            depths[i] = depths[parent] + 1;
+            const mxArray* parent_path = mxGetField(node_elements, parent, "path");
+            path = mxCreateCellMatrix(1, 1 + 2 * depths[i]);
+            for (unsigned p = 0; p < 1 + 2 * depths[parent]; p++) {
+                mxSetCell(path, p, mxDuplicateArray(mxGetCell(parent_path, p)));
+            }
+            mxSetCell(path, 2 * depths[i] - 1, mxCreateString("children"));
+            mxSetCell(path, 2 * depths[i], mxCreateDoubleScalar(walk.child_numbers[i]));
+        }
+        mxSetField(node_elements, i, "path", path);
+    }
+    
+    return node_elements;
+}
+
+// bounds, as 3x2 column-major boxes [xmin ymin zmin xmax ymax zmax]
+
+template <typename T>
+static void append_indices(const T* data, size_t first, size_t count, std::vector<unsigned>* indices) {
+    for (size_t i = first; i < first + count; i++) {
+        indices->push_back(data[i]);
+    }
+}
+
+// append any numeric mesh indices as unsigned
+static void append_indices(const mxArray* matlab_indices, size_t first, size_t count, std::vector<unsigned>* indices) {
+    if (!matlab_indices || first + count > mxGetNumberOfElements(matlab_indices)) {
+        return;
+    }
+    
+    const void* data = mxGetData(matlab_indices);
+    switch (mxGetClassID(matlab_indices)) {
+        case mxUINT32_CLASS:
+            append_indices((const uint32_T*)data, first, count, indices);
+            break;
+        case mxINT32_CLASS:
+            append_indices((const int32_T*)data, first, count, indices);
+            break;
+        case mxDOUBLE_CLASS:
+            append_indices((const double*)data, first, count, indices);
+            break;
+        case mxSINGLE_CLASS:
+            append_indices((const float*)data, first, count, indices);
+            break;
+        default:
+            break;
+    }
+}
+
+static std::string node_name(const mxArray* matlab_name) {
+    if (!matlab_name || !mxIsChar(matlab_name)) {
+        return std::string();
+    }
+    char* name = mxArrayToString(matlab_name);
+    std::string node_name(name ? name : "");
+    mxFree(name);
+    return node_name;
+}
+
+// which nodes to skip, and mesh indices of the rest as compressed rows
+static void node_meshes(const mxArray* root_node, bool is_flat, const node_walk& walk, const std::set<std::string>& ignore_nodes,
+        std::vector<unsigned>* offsets, std::vector<unsigned>* indices) {
+    unsigned num_nodes = walk.parents.size();
+    const mxArray* flat_names = is_flat ? mxGetField(root_node, 0, "names") : 0;
+    const mxArray* flat_offsets = is_flat ? mxGetField(root_node, 0, "meshOffsets") : 0;
+    const mxArray* flat_indices = is_flat ? mxGetField(root_node, 0, "meshIndices") : 0;
+    if (flat_offsets && (!mxIsUint32(flat_offsets) || num_nodes + 1 != mxGetNumberOfElements(flat_offsets))) {
+        flat_offsets = 0;
+    }
+    if (flat_names && (!mxIsCell(flat_names) || num_nodes != mxGetNumberOfElements(flat_names))) {
+        flat_names = 0;
+    }
+    
+    offsets->assign(1, 0);
+    for (unsigned i = 0; i < num_nodes; i++) {
+        if (!ignore_nodes.empty()) {
+            const mxArray* name = is_flat
+                    ? (flat_names ? mxGetCell(flat_names, i) : 0)
+                    : mxGetField(walk.arrays[i], walk.indices[i], "name");
+            if (ignore_nodes.count(node_name(name))) {
+                offsets->push_back(indices->size());
+                continue;
+            }
+        }
+        
+        if (is_flat) {
+            if (flat_offsets) {
+                const uint32_T* node_offsets = (const uint32_T*)mxGetData(flat_offsets);
+                if (node_offsets[i] <= node_offsets[i + 1]) {
+                    append_indices(flat_indices, node_offsets[i], node_offsets[i + 1] - node_offsets[i], indices);
+                }
+            }
+        } else {
+            const mxArray* mesh_indices = mxGetField(walk.arrays[i], walk.indices[i], "meshIndices");
+            if (mesh_indices) {
+                append_indices(mesh_indices, 0, mxGetNumberOfElements(mesh_indices), indices);
+            }
+        }
+        offsets->push_back(indices->size());
+    }
+}
+
+// box from the mesh's bounds field, or else from its vertices
+static bool mesh_box(const mxArray* matlab_meshes, unsigned index, double* box) {
+    const mxArray* bounds = mxGetField(matlab_meshes, index, "bounds");
+    if (bounds && mxIsDouble(bounds) && 6 == mxGetNumberOfElements(bounds)) {
+        memcpy(box, mxGetPr(bounds), 6 * sizeof(double));
+        return true;
+    }
+    
+    const mxArray* vertices = mxGetField(matlab_meshes, index, "vertices");
+    if (!vertices || 3 != mxGetM(vertices) || 0 == mxGetN(vertices)) {
+        return false;
+    }
+    
+    if (mxIsDouble(vertices)) {
+        mexximp::bound_xyz(mxGetPr(vertices), mxGetN(vertices), &box[0], &box[3]);
+        return true;
+    }
+    
+    if (mxIsSingle(vertices)) {
+        float mins[3], maxes[3];
+        mexximp::bound_xyz((const float*)mxGetData(vertices), mxGetN(vertices), mins, maxes);
+        for (unsigned c = 0; c < 3; c++) {
+            box[c] = mins[c];
+            box[c + 3] = maxes[c];
+        }
+        return true;
+    }
+    
+    return false;
+}
+
+// transform a local box to a world box, exactly as if transforming its 8 corners
+// Matlab transforms take row vectors: world = [x y z 1] * transform
+static void transform_box(const double* transform, const double* box, double* world_box) {
+    for (unsigned j = 0; j < 3; j++) {
+        double low = transform[3 + 4 * j];
+        double high = low;
+        for (unsigned k = 0; k < 3; k++) {
+            double a = transform[k + 4 * j] * box[k];
+            double b = transform[k + 4 * j] * box[k + 3];
+            low += a < b ? a : b;
+            high += a < b ? b : a;
+        }
+        world_box[j] = low;
+        world_box[j + 3] = high;
+    }
+}
+
+static void merge_box(const double* box, double* grand_box, bool* is_valid) {
+    for (unsigned c = 0; c < 3; c++) {
+        if (!*is_valid || box[c] < grand_box[c]) {
+            grand_box[c] = box[c];
+        }
+        if (!*is_valid || box[c + 3] > grand_box[c + 3]) {
+            grand_box[c + 3] = box[c + 3];
+        }
+    }
+    *is_valid = true;
+}
+
+static void scene_bounds(const mxArray* scene, const mxArray* root_node, bool is_flat, node_walk* walk,
+        const std::set<std::string>& ignore_nodes, mxArray** scene_box, mxArray** node_boxes, mxArray** mesh_boxes) {
+    accumulate_transforms(walk);
+    
+    // local box for each mesh, up front
+    const mxArray* matlab_meshes = mxGetField(scene, 0, "meshes");
+    unsigned num_meshes = matlab_meshes && mxIsStruct(matlab_meshes) ? mxGetNumberOfElements(matlab_meshes) : 0;
+    mwSize mesh_dims[3] = {3, 2, num_meshes};
+    *mesh_boxes = mxCreateNumericArray(3, &mesh_dims[0], mxDOUBLE_CLASS, mxREAL);
+    double* mesh_data = mxGetPr(*mesh_boxes);
+    std::vector<bool> mesh_valid(num_meshes, false);
+    for (unsigned m = 0; m < num_meshes; m++) {
+        mesh_valid[m] = mesh_box(matlab_meshes, m, &mesh_data[6 * m]);
+        if (!mesh_valid[m]) {
+            for (unsigned e = 0; e < 6; e++) {
+                mesh_data[6 * m + e] = mxGetNaN();
+            }
+        }
+    }
+    
+    // world box for each node's own meshes
+    std::vector<unsigned> offsets;
+    std::vector<unsigned> indices;
+    node_meshes(root_node, is_flat, *walk, ignore_nodes, &offsets, &indices);
+    
+    unsigned num_nodes = walk->parents.size();
+    mwSize node_dims[3] = {3, 2, num_nodes};
+    *node_boxes = mxCreateNumericArray(3, &node_dims[0], mxDOUBLE_CLASS, mxREAL);
+    double* node_data = mxGetPr(*node_boxes);
+    std::vector<bool> node_valid(num_nodes, false);
+    for (unsigned i = 0; i < num_nodes; i++) {
+        bool is_valid = false;
+        for (unsigned n = offsets[i]; n < offsets[i + 1]; n++) {
+            unsigned m = indices[n];
+            if (m >= num_meshes || !mesh_valid[m]) {
+                continue;
+            }
+            double world_box[6];
+            transform_box(&walk->transforms[16 * i], &mesh_data[6 * m], world_box);
+            merge_box(world_box, &node_data[6 * i], &is_valid);
+        }
+        node_valid[i] = is_valid;
+    }
+    
+    // children come after parents, so merge backwards into each parent
+    for (unsigned i = num_nodes; i > 1; i--) {
+        unsigned child = i - 1;
+        if (node_valid[child]) {
+            bool is_valid = node_valid[walk->parents[child]];
+            merge_box(&node_data[6 * child], &node_data[6 * walk->parents[child]], &is_valid);
+            node_valid[walk->parents[child]] = is_valid;
+        }
+    }
+    
+    for (unsigned i = 0; i < num_nodes; i++) {
+        if (!node_valid[i]) {
+            for (unsigned e = 0; e < 6; e++) {
+                node_data[6 * i + e] = mxGetNaN();
+            }
+        }
+    }
+    
+    if (0 < num_nodes && node_valid[0]) {
+        *scene_box = mxCreateDoubleMatrix(3, 2, mxREAL);
+        memcpy(mxGetPr(*scene_box), &node_data[0], 6 * sizeof(double));
+    } else {
+        *scene_box = mexximp::emptyDouble();
+    }
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    if (nrhs < 2 || !mxIsChar(prhs[0]) || !mxIsStruct(prhs[1])) {
+        printUsage();
+        plhs[0] = mexximp::emptyDouble();
+        return;
+    }
+    
+    const mxArray* root_node = mxGetField(prhs[1], 0, "rootNode");
+    char* command = mxArrayToString(prhs[0]);
+    if (!root_node || !mxIsStruct(root_node) || mxIsEmpty(root_node) || !command) {
+        printUsage();
+        plhs[0] = mexximp::emptyDouble();
+        mxFree(command);
+        return;
+    }
+    
+    node_walk walk;
+    bool is_flat = 0 <= mxGetFieldNumber(root_node, "parents");
+    if (is_flat) {
+        if (!walk_flat_nodes(root_node, &walk)) {
+            mexPrintf("Invalid flat node parents.\n");
+            plhs[0] = mexximp::emptyDouble();
+            mxFree(command);
+            return;
+        }
+    } else {
+        walk_nested_nodes(root_node, &walk);
+    }
+    
+    if (0 == strcmp("world", command)) {
+        accumulate_transforms(&walk);
+        plhs[0] = world_transforms(walk);
+        if (1 < nlhs) {
+            plhs[1] = parent_indices(walk);
+        }
+        
+    } else if (0 == strcmp("flatten", command) && !is_flat) {
+        accumulate_transforms(&walk);
+        plhs[0] = flatten_nodes(walk);
+        
+    } else if (0 == strcmp("paths", command) && !is_flat) {
+        plhs[0] = node_paths(walk);
+        
+    } else if (0 == strcmp("bounds", command)) {
+        std::set<std::string> ignore_nodes;
+        if (2 < nrhs && mxIsCell(prhs[2])) {
+            unsigned num_ignore = mxGetNumberOfElements(prhs[2]);
+            for (unsigned i = 0; i < num_ignore; i++) {
+                ignore_nodes.insert(node_name(mxGetCell(prhs[2], i)));
+            }
+        }
+        
+        mxArray* node_boxes;
+        mxArray* mesh_boxes;
+        scene_bounds(prhs[1], root_node, is_flat, &walk, ignore_nodes, &plhs[0], &node_boxes, &mesh_boxes);
+        if (1 < nlhs) {
+            plhs[1] = node_boxes;
+        } else {
+            mxDestroyArray(node_boxes);
+        }
+        if (2 < nlhs) {
+            plhs[2] = mesh_boxes;
+        } else {
+            mxDestroyArray(mesh_boxes);
+        }
+        
+    } else {
+        printUsage();
+        plhs[0] = mexximp::emptyDouble();
+    }
+    
+    mxFree(command);
+}
@@ -0,0 +1,222 @@
+// Stream triangle meshes to binary PLY files, for utilities like mexximpWriteTriangleMeshPly.
+
+#include <mex.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "mexximp_constants.h"
+#include "mexximp_kernels.h"
+#include "mexximp_util.h"
+
+void printUsage() {
+    mexPrintf("Write a binary little-endian PLY triangle mesh:\n");
+    mexPrintf("  status = mexximpWritePly(outputFile, xyz, faces, normals, uvs, colors)\n");
+    mexPrintf("xyz, normals, and colors are 3xn, uvs are 2xn, all single or double.\n");
+    mexPrintf("normals, uvs, and colors are optional, and skipped unless they have n columns.\n");
+    mexPrintf("faces is 3xm of any numeric type, written as-is as uint32 vertex indices.\n");
+    mexPrintf("status is 0 on success.\n");
+    mexPrintf("\n");
+}
+
+// vertices and faces are converted and written this many at a time
+static const size_t chunk_size = 64 * 1024;
+
+// one per-vertex attribute, like xyz or normals
+struct ply_attribute {
+    const mxArray* array;
+    unsigned num_components;
+    const char* names[3];
+};
+
+static bool is_little_endian() {
+    const uint32_t one = 1;
+    unsigned char first;
+    memcpy(&first, &one, 1);
+    return 1 == first;
+}
+
+// PLY data is little-endian, whatever the host
+static void to_little_endian(uint32_t* words, size_t num_words) {
+    if (is_little_endian()) {
+        return;
+    }
+    for (size_t i = 0; i < num_words; i++) {
+        uint32_t w = words[i];
+        words[i] = (w >> 24) | ((w >> 8) & 0x0000FF00) | ((w << 8) & 0x00FF0000) | (w << 24);
+    }
+}
+
+static bool is_attribute(const mxArray* matlab_array, unsigned num_components, size_t num_vertices) {
+    return matlab_array
+            && (mxIsDouble(matlab_array) || mxIsSingle(matlab_array))
+            && !mxIsComplex(matlab_array)
+            && num_components == mxGetM(matlab_array)
+            && num_vertices == mxGetN(matlab_array);
+}
+
+static bool write_header(FILE* file, const std::vector<ply_attribute>& attributes, size_t num_vertices, size_t num_faces) {
+    fprintf(file, "ply\r\n");
+    fprintf(file, "format binary_little_endian 1.0\r\n");
+    fprintf(file, "element vertex %lu\r\n", (unsigned long)num_vertices);
+    for (unsigned a = 0; a < attributes.size(); a++) {
+        for (unsigned c = 0; c < attributes[a].num_components; c++) {
+            fprintf(file, "property float32 %s\r\n", attributes[a].names[c]);
+        }
+    }
+    fprintf(file, "element face %lu\r\n", (unsigned long)num_faces);
+    fprintf(file, "property list uint32 uint32 vertex_indices\r\n");
+    return 0 < fprintf(file, "end_header\r\n");
+}
+
+// interleave attributes into float32 vertex records, one chunk at a time
+static bool write_vertices(FILE* file, const std::vector<ply_attribute>& attributes, size_t num_vertices) {
+    unsigned floats_per_vertex = 0;
+    for (unsigned a = 0; a < attributes.size(); a++) {
+        floats_per_vertex += attributes[a].num_components;
+    }
+    
+    std::vector<float> narrowed(3 * chunk_size);
+    std::vector<float> records(floats_per_vertex * chunk_size);
+    for (size_t first = 0; first < num_vertices; first += chunk_size) {
+        size_t count = num_vertices - first < chunk_size ? num_vertices - first : chunk_size;
+        
+        unsigned column = 0;
+        for (unsigned a = 0; a < attributes.size(); a++) {
+            unsigned num_components = attributes[a].num_components;
+            size_t num_elements = num_components * count;
+            const float* source;
+            if (mxIsDouble(attributes[a].array)) {
+                mexximp::narrow_doubles(mxGetPr(attributes[a].array) + num_components * first, narrowed.data(), num_elements);
+                source = narrowed.data();
+            } else {
+                source = (const float*)mxGetData(attributes[a].array) + num_components * first;
+            }
+            
+            for (size_t v = 0; v < count; v++) {
+                memcpy(&records[floats_per_vertex * v + column], &source[num_components * v], num_components * sizeof(float));
+            }
+            column += num_components;
+        }
+        
+        to_little_endian((uint32_t*)records.data(), floats_per_vertex * count);
+        if (count != fwrite(records.data(), floats_per_vertex * sizeof(float), count, file)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+static void face_records(const T* faces, size_t count, uint32_t* records) {
+    for (size_t f = 0; f < count; f++) {
+        records[4 * f] = 3;
+        records[4 * f + 1] = (uint32_t)faces[3 * f];
+        records[4 * f + 2] = (uint32_t)faces[3 * f + 1];
+        records[4 * f + 3] = (uint32_t)faces[3 * f + 2];
+    }
+}
+
+// each face is a list of 3 uint32 indices, prefixed with a uint32 count of 3
+static bool write_faces(FILE* file, const mxArray* matlab_faces, size_t num_faces) {
+    std::vector<uint32_t> records(4 * chunk_size);
+    const char* data = (const char*)mxGetData(matlab_faces);
+    size_t element_size = mxGetElementSize(matlab_faces);
+    for (size_t first = 0; first < num_faces; first += chunk_size) {
+        size_t count = num_faces - first < chunk_size ? num_faces - first : chunk_size;
+        const void* faces = data + 3 * first * element_size;
+        switch (mxGetClassID(matlab_faces)) {
+            case mxUINT32_CLASS:
+                face_records((const uint32_T*)faces, count, records.data());
+                break;
+            case mxINT32_CLASS:
+                face_records((const int32_T*)faces, count, records.data());
+                break;
+            case mxDOUBLE_CLASS:
+                face_records((const double*)faces, count, records.data());
+                break;
+            case mxSINGLE_CLASS:
+                face_records((const float*)faces, count, records.data());
+                break;
+            case mxUINT16_CLASS:
+                face_records((const uint16_T*)faces, count, records.data());
+                break;
+            case mxINT16_CLASS:
+                face_records((const int16_T*)faces, count, records.data());
+                break;
+            case mxUINT8_CLASS:
+                face_records((const uint8_T*)faces, count, records.data());
+                break;
+            case mxINT8_CLASS:
+                face_records((const int8_T*)faces, count, records.data());
+                break;
+            case mxUINT64_CLASS:
+                face_records((const uint64_T*)faces, count, records.data());
+                break;
+            case mxINT64_CLASS:
+                face_records((const int64_T*)faces, count, records.data());
+                break;
+            default:
+                return false;
+        }
+        
+        to_little_endian(records.data(), 4 * count);
+        if (count != fwrite(records.data(), 4 * sizeof(uint32_t), count, file)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    if (nrhs < 3 || !mxIsChar(prhs[0]) || !mxIsNumeric(prhs[2]) || mxIsComplex(prhs[2]) || 3 != mxGetM(prhs[2])) {
+        printUsage();
+        plhs[0] = mexximp::emptyDouble();
+        return;
+    }
+    
+    size_t num_vertices = mxGetN(prhs[1]);
+    if (!is_attribute(prhs[1], 3, num_vertices)) {
+        printUsage();
+        plhs[0] = mexximp::emptyDouble();
+        return;
+    }
+    
+    // xyz, then whichever optional attributes match the vertices
+    const ply_attribute xyz = {prhs[1], 3, {"x", "y", "z"}};
+    std::vector<ply_attribute> attributes(1, xyz);
+    if (3 < nrhs && is_attribute(prhs[3], 3, num_vertices)) {
+        const ply_attribute normals = {prhs[3], 3, {"nx", "ny", "nz"}};
+        attributes.push_back(normals);
+    }
+    if (4 < nrhs && is_attribute(prhs[4], 2, num_vertices)) {
+        const ply_attribute uvs = {prhs[4], 2, {"u", "v", 0}};
+        attributes.push_back(uvs);
+    }
+    if (5 < nrhs && is_attribute(prhs[5], 3, num_vertices)) {
+        const ply_attribute colors = {prhs[5], 3, {"red", "green", "blue"}};
+        attributes.push_back(colors);
+    }
+    
+    char* output_file = mxArrayToString(prhs[0]);
+    FILE* file = output_file ? fopen(output_file, "wb") : 0;
+    if (!file) {
+        mexPrintf("Could not open PLY file <%s> for writing.\n", output_file ? output_file : "");
+        plhs[0] = mxCreateDoubleScalar(-1);
+        mxFree(output_file);
+        return;
+    }
+    
+    size_t num_faces = mxGetN(prhs[2]);
+    bool is_written = write_header(file, attributes, num_vertices, num_faces)
+            && write_vertices(file, attributes, num_vertices)
+            && write_faces(file, prhs[2], num_faces);
+    is_written = 0 == fclose(file) && is_written;
+    if (!is_written) {
+        mexPrintf("Could not write PLY file <%s>.\n", output_file);
+    }
+    
+    plhs[0] = mxCreateDoubleScalar(is_written ? 0 : -1);
+    mxFree(output_file);
+}
@@ -2,7 +2,12 @@
 #include "mexximp_scene.h"
 #include "mexximp_util.h"
 #include "mexximp_constants.h"
+#include "mexximp_kernels.h"
+#include "mexximp_threads.h"
 
+#include <algorithm>
+#include <math.h>
+#include <cstring>
 #include <mex.h>
 #include <matrix.h>
 
@@ -10,8 +15,20 @@ namespace mexximp {
     
     // scene (top-level)
     
-    // caller must pass in a newed aiScene
-    unsigned to_assimp_scene(const mxArray* matlab_scene, aiScene* assimp_scene) {
+    static unsigned count_nodes(const aiNode* assimp_node) {
+        if (!assimp_node) {
+            return 0;
+        }
+        
+        unsigned num_nodes = 1;
+        for (unsigned i = 0; i < assimp_node->mNumChildren; i++) {
+            num_nodes += count_nodes(assimp_node->mChildren[i]);
+        }
+        return num_nodes;
+    }
+    
+    // caller must pass in a newed aiScene, and an arena that outlives it when options.use_arena
+    unsigned to_assimp_scene(const mxArray* matlab_scene, aiScene* assimp_scene, const export_options& options, arena* scene_arena, timing_report* timing) {
         if (!matlab_scene || !assimp_scene || !mxIsStruct(matlab_scene)) {
             return 0;
         }
@@ -20,28 +37,41 @@ namespace mexximp {
             return 0;
         }
         
+        // export phases count the Matlab bytes they read
+        phase_scope cameras_phase(timing);
         mxArray* matlab_cameras = mxGetField(matlab_scene, 0, "cameras");
         assimp_scene->mNumCameras = to_assimp_cameras(matlab_cameras, &assimp_scene->mCameras);
+        cameras_phase.finish("cameras", assimp_scene->mNumCameras, matlab_cameras);
         
+        phase_scope lights_phase(timing);
         mxArray* matlab_lights = mxGetField(matlab_scene, 0, "lights");
         assimp_scene->mNumLights = to_assimp_lights(matlab_lights, &assimp_scene->mLights);
+        lights_phase.finish("lights", assimp_scene->mNumLights, matlab_lights);
         
+        phase_scope materials_phase(timing);
         mxArray* matlab_materials = mxGetField(matlab_scene, 0, "materials");
-        assimp_scene->mNumMaterials = to_assimp_materials(matlab_materials, &assimp_scene->mMaterials);
+        assimp_scene->mNumMaterials = to_assimp_materials(matlab_materials, &assimp_scene->mMaterials, scene_arena);
+        materials_phase.finish("materials", assimp_scene->mNumMaterials, matlab_materials);
         
+        phase_scope meshes_phase(timing);
         mxArray* matlab_meshes = mxGetField(matlab_scene, 0, "meshes");
-        assimp_scene->mNumMeshes = to_assimp_meshes(matlab_meshes, &assimp_scene->mMeshes);
+        assimp_scene->mNumMeshes = to_assimp_meshes(matlab_meshes, &assimp_scene->mMeshes, options, scene_arena);
+        meshes_phase.finish("meshes", assimp_scene->mNumMeshes, matlab_meshes);
         
+        phase_scope nodes_phase(timing);
         mxArray* matlab_node = mxGetField(matlab_scene, 0, "rootNode");
         to_assimp_nodes(matlab_node, 0, &assimp_scene->mRootNode, 0);
+        nodes_phase.finish("nodes", timing ? count_nodes(assimp_scene->mRootNode) : 0, matlab_node);
         
+        phase_scope textures_phase(timing);
         mxArray* matlab_textures = mxGetField(matlab_scene, 0, "embeddedTextures");
         assimp_scene->mNumTextures = to_assimp_textures(matlab_textures, &assimp_scene->mTextures);
+        textures_phase.finish("textures", assimp_scene->mNumTextures, matlab_textures);
         
         return 1;
     }
     
-    unsigned to_matlab_scene(const aiScene* assimp_scene, mxArray** matlab_scene) {
+    unsigned to_matlab_scene(const aiScene* assimp_scene, mxArray** matlab_scene, const import_options& options, timing_report* timing) {
         if (!matlab_scene) {
             return 0;
         }
@@ -56,33 +86,50 @@ namespace mexximp {
             return 0;
         }
         
+        // import phases count the Matlab bytes they produce
+        phase_scope cameras_phase(timing);
         mxArray* matlab_cameras;
         to_matlab_cameras(assimp_scene->mCameras, &matlab_cameras, assimp_scene->mNumCameras);
         mxSetField(*matlab_scene, 0, "cameras", matlab_cameras);
+        cameras_phase.finish("cameras", assimp_scene->mNumCameras, matlab_cameras);
         
+        phase_scope lights_phase(timing);
         mxArray* matlab_lights;
         to_matlab_lights(assimp_scene->mLights, &matlab_lights, assimp_scene->mNumLights);
         mxSetField(*matlab_scene, 0, "lights", matlab_lights);
+        lights_phase.finish("lights", assimp_scene->mNumLights, matlab_lights);
         
+        phase_scope materials_phase(timing);
         mxArray* matlab_materials;
         to_matlab_materials(assimp_scene->mMaterials, &matlab_materials, assimp_scene->mNumMaterials);
         mxSetField(*matlab_scene, 0, "materials", matlab_materials);
+        materials_phase.finish("materials", assimp_scene->mNumMaterials, matlab_materials);
         
+        // adds separate meshes and faces phases
         mxArray* matlab_meshes;
-        to_matlab_meshes(assimp_scene->mMeshes, &matlab_meshes, assimp_scene->mNumMeshes);
+        to_matlab_meshes(assimp_scene->mMeshes, &matlab_meshes, assimp_scene->mNumMeshes, options, timing);
         mxSetField(*matlab_scene, 0, "meshes", matlab_meshes);
         
-        mxArray* matlab_node = mxCreateStructMatrix(
-                1,
-                1,
-                COUNT(node_field_names),
-                &node_field_names[0]);
-        to_matlab_nodes(assimp_scene->mRootNode, &matlab_node, 0);
+        phase_scope nodes_phase(timing);
+        mxArray* matlab_node;
+        if (options.flat_nodes) {
+            to_matlab_flat_nodes(assimp_scene->mRootNode, &matlab_node);
+        } else {
+            matlab_node = mxCreateStructMatrix(
+                    1,
+                    1,
+                    COUNT(node_field_names),
+                    &node_field_names[0]);
+            to_matlab_nodes(assimp_scene->mRootNode, &matlab_node, 0);
+        }
         mxSetField(*matlab_scene, 0, "rootNode", matlab_node);
+        nodes_phase.finish("nodes", timing ? count_nodes(assimp_scene->mRootNode) : 0, matlab_node);
         
+        phase_scope textures_phase(timing);
         mxArray* matlab_textures;
         to_matlab_textures(assimp_scene->mTextures, &matlab_textures, assimp_scene->mNumTextures);
         mxSetField(*matlab_scene, 0, "embeddedTextures", matlab_textures);
+        textures_phase.finish("textures", assimp_scene->mNumTextures, matlab_textures);
         
         return 1;
     }
@@ -100,17 +147,26 @@ namespace mexximp {
             return 0;
         }
         
+        const int position_field = field_number(matlab_cameras, "position");
+        const int look_at_direction_field = field_number(matlab_cameras, "lookAtDirection");
+        const int up_direction_field = field_number(matlab_cameras, "upDirection");
+        const int name_field = field_number(matlab_cameras, "name");
+        const int aspect_ratio_field = field_number(matlab_cameras, "aspectRatio");
+        const int clip_plane_near_field = field_number(matlab_cameras, "clipPlaneNear");
+        const int clip_plane_far_field = field_number(matlab_cameras, "clipPlaneFar");
+        const int horizontal_fov_field = field_number(matlab_cameras, "horizontalFov");
+        
         for (unsigned i = 0; i < num_cameras; i++) {
             (*assimp_cameras)[i] = new aiCamera();
             
-            get_xyz_in_place(matlab_cameras, i, "position", &(*assimp_cameras)[i]->mPosition);
-            get_xyz_in_place(matlab_cameras, i, "lookAtDirection", &(*assimp_cameras)[i]->mLookAt);
-            get_xyz_in_place(matlab_cameras, i, "upDirection", &(*assimp_cameras)[i]->mUp);
-            get_string(matlab_cameras, i, "name", &(*assimp_cameras)[i]->mName, "camera");
-            (*assimp_cameras)[i]->mAspect = get_scalar(matlab_cameras, i, "aspectRatio", 1.0);
-            (*assimp_cameras)[i]->mClipPlaneNear = get_scalar(matlab_cameras, i, "clipPlaneNear", 0.1);
-            (*assimp_cameras)[i]->mClipPlaneFar = get_scalar(matlab_cameras, i, "clipPlaneFar", 1000);
-            (*assimp_cameras)[i]->mHorizontalFOV = get_scalar(matlab_cameras, i, "horizontalFov", 3.14159/4.0);
+            get_xyz_in_place(matlab_cameras, i, position_field, &(*assimp_cameras)[i]->mPosition);
+            get_xyz_in_place(matlab_cameras, i, look_at_direction_field, &(*assimp_cameras)[i]->mLookAt);
+            get_xyz_in_place(matlab_cameras, i, up_direction_field, &(*assimp_cameras)[i]->mUp);
+            get_string(matlab_cameras, i, name_field, &(*assimp_cameras)[i]->mName, "camera");
+            (*assimp_cameras)[i]->mAspect = get_scalar(matlab_cameras, i, aspect_ratio_field, 1.0);
+            (*assimp_cameras)[i]->mClipPlaneNear = get_scalar(matlab_cameras, i, clip_plane_near_field, 0.1);
+            (*assimp_cameras)[i]->mClipPlaneFar = get_scalar(matlab_cameras, i, clip_plane_far_field, 1000);
+            (*assimp_cameras)[i]->mHorizontalFOV = get_scalar(matlab_cameras, i, horizontal_fov_field, 3.14159/4.0);
         }
         
         return num_cameras;
@@ -132,15 +188,24 @@ namespace mexximp {
                 COUNT(camera_field_names),
                 &camera_field_names[0]);
         
+        const int position_field = field_number(*matlab_cameras, "position");
+        const int look_at_direction_field = field_number(*matlab_cameras, "lookAtDirection");
+        const int up_direction_field = field_number(*matlab_cameras, "upDirection");
+        const int name_field = field_number(*matlab_cameras, "name");
+        const int aspect_ratio_field = field_number(*matlab_cameras, "aspectRatio");
+        const int clip_plane_near_field = field_number(*matlab_cameras, "clipPlaneNear");
+        const int clip_plane_far_field = field_number(*matlab_cameras, "clipPlaneFar");
+        const int horizontal_fov_field = field_number(*matlab_cameras, "horizontalFov");
+        
         for (unsigned i = 0; i < num_cameras; i++) {
-            set_xyz(*matlab_cameras, i, "position", &assimp_cameras[i]->mPosition, 1);
-            set_xyz(*matlab_cameras, i, "lookAtDirection", &assimp_cameras[i]->mLookAt, 1);
-            set_xyz(*matlab_cameras, i, "upDirection", &assimp_cameras[i]->mUp, 1);
-            set_string(*matlab_cameras, i, "name", &assimp_cameras[i]->mName);
-            set_scalar(*matlab_cameras, i, "aspectRatio", assimp_cameras[i]->mAspect);
-            set_scalar(*matlab_cameras, i, "clipPlaneNear", assimp_cameras[i]->mClipPlaneNear);
-            set_scalar(*matlab_cameras, i, "clipPlaneFar", assimp_cameras[i]->mClipPlaneFar);
-            set_scalar(*matlab_cameras, i, "horizontalFov", assimp_cameras[i]->mHorizontalFOV);
+            set_xyz(*matlab_cameras, i, position_field, &assimp_cameras[i]->mPosition, 1);
+            set_xyz(*matlab_cameras, i, look_at_direction_field, &assimp_cameras[i]->mLookAt, 1);
+            set_xyz(*matlab_cameras, i, up_direction_field, &assimp_cameras[i]->mUp, 1);
+            set_string(*matlab_cameras, i, name_field, &assimp_cameras[i]->mName);
+            set_scalar(*matlab_cameras, i, aspect_ratio_field, assimp_cameras[i]->mAspect);
+            set_scalar(*matlab_cameras, i, clip_plane_near_field, assimp_cameras[i]->mClipPlaneNear);
+            set_scalar(*matlab_cameras, i, clip_plane_far_field, assimp_cameras[i]->mClipPlaneFar);
+            set_scalar(*matlab_cameras, i, horizontal_fov_field, assimp_cameras[i]->mHorizontalFOV);
         }
         
         return num_cameras;
@@ -159,21 +224,34 @@ namespace mexximp {
             return 0;
         }
         
+        const int ambient_color_field = field_number(matlab_lights, "ambientColor");
+        const int diffuse_color_field = field_number(matlab_lights, "diffuseColor");
+        const int specular_color_field = field_number(matlab_lights, "specularColor");
+        const int position_field = field_number(matlab_lights, "position");
+        const int look_at_direction_field = field_number(matlab_lights, "lookAtDirection");
+        const int name_field = field_number(matlab_lights, "name");
+        const int type_field = field_number(matlab_lights, "type");
+        const int inner_cone_angle_field = field_number(matlab_lights, "innerConeAngle");
+        const int outer_cone_angle_field = field_number(matlab_lights, "outerConeAngle");
+        const int constant_attenuation_field = field_number(matlab_lights, "constantAttenuation");
+        const int linear_attenuation_field = field_number(matlab_lights, "linearAttenuation");
+        const int quadratic_attenuation_field = field_number(matlab_lights, "quadraticAttenuation");
+        
         for (unsigned i = 0; i < num_lights; i++) {
             (*assimp_lights)[i] = new aiLight();
             
-            get_rgb_in_place(matlab_lights, i, "ambientColor", &(*assimp_lights)[i]->mColorAmbient);
-            get_rgb_in_place(matlab_lights, i, "diffuseColor", &(*assimp_lights)[i]->mColorDiffuse);
-            get_rgb_in_place(matlab_lights, i, "specularColor", &(*assimp_lights)[i]->mColorSpecular);
-            get_xyz_in_place(matlab_lights, i, "position", &(*assimp_lights)[i]->mPosition);
-            get_xyz_in_place(matlab_lights, i, "lookAtDirection", &(*assimp_lights)[i]->mDirection);
-            get_string(matlab_lights, i, "name", &(*assimp_lights)[i]->mName, "light");
-            (*assimp_lights)[i]->mType = light_type_code(get_c_string(matlab_lights, i, "type", "undefined"));
-            (*assimp_lights)[i]->mAngleInnerCone = get_scalar(matlab_lights, i, "innerConeAngle", 2*3.14159);
-            (*assimp_lights)[i]->mAngleOuterCone = get_scalar(matlab_lights, i, "outerConeAngle", 2*3.14159);
-            (*assimp_lights)[i]->mAttenuationConstant = get_scalar(matlab_lights, i, "constantAttenuation", 1);
-            (*assimp_lights)[i]->mAttenuationLinear = get_scalar(matlab_lights, i, "linearAttenuation", 0);
-            (*assimp_lights)[i]->mAttenuationQuadratic = get_scalar(matlab_lights, i, "quadraticAttenuation", 0);
+            get_rgb_in_place(matlab_lights, i, ambient_color_field, &(*assimp_lights)[i]->mColorAmbient);
+            get_rgb_in_place(matlab_lights, i, diffuse_color_field, &(*assimp_lights)[i]->mColorDiffuse);
+            get_rgb_in_place(matlab_lights, i, specular_color_field, &(*assimp_lights)[i]->mColorSpecular);
+            get_xyz_in_place(matlab_lights, i, position_field, &(*assimp_lights)[i]->mPosition);
+            get_xyz_in_place(matlab_lights, i, look_at_direction_field, &(*assimp_lights)[i]->mDirection);
+            get_string(matlab_lights, i, name_field, &(*assimp_lights)[i]->mName, "light");
+            (*assimp_lights)[i]->mType = light_type_code(get_c_string(matlab_lights, i, type_field, "undefined"));
+            (*assimp_lights)[i]->mAngleInnerCone = get_scalar(matlab_lights, i, inner_cone_angle_field, 2*3.14159);
+            (*assimp_lights)[i]->mAngleOuterCone = get_scalar(matlab_lights, i, outer_cone_angle_field, 2*3.14159);
+            (*assimp_lights)[i]->mAttenuationConstant = get_scalar(matlab_lights, i, constant_attenuation_field, 1);
+            (*assimp_lights)[i]->mAttenuationLinear = get_scalar(matlab_lights, i, linear_attenuation_field, 0);
+            (*assimp_lights)[i]->mAttenuationQuadratic = get_scalar(matlab_lights, i, quadratic_attenuation_field, 0);
         }
         
         return num_lights;
@@ -195,19 +273,32 @@ namespace mexximp {
                 COUNT(light_field_names),
                 &light_field_names[0]);
         
+        const int ambient_color_field = field_number(*matlab_lights, "ambientColor");
+        const int diffuse_color_field = field_number(*matlab_lights, "diffuseColor");
+        const int specular_color_field = field_number(*matlab_lights, "specularColor");
+        const int position_field = field_number(*matlab_lights, "position");
+        const int look_at_direction_field = field_number(*matlab_lights, "lookAtDirection");
+        const int name_field = field_number(*matlab_lights, "name");
+        const int type_field = field_number(*matlab_lights, "type");
+        const int inner_cone_angle_field = field_number(*matlab_lights, "innerConeAngle");
+        const int outer_cone_angle_field = field_number(*matlab_lights, "outerConeAngle");
+        const int constant_attenuation_field = field_number(*matlab_lights, "constantAttenuation");
+        const int linear_attenuation_field = field_number(*matlab_lights, "linearAttenuation");
+        const int quadratic_attenuation_field = field_number(*matlab_lights, "quadraticAttenuation");
+        
         for (unsigned i = 0; i < num_lights; i++) {
-            set_rgb(*matlab_lights, i, "ambientColor", &assimp_lights[i]->mColorAmbient, 1);
-            set_rgb(*matlab_lights, i, "diffuseColor", &assimp_lights[i]->mColorDiffuse, 1);
-            set_rgb(*matlab_lights, i, "specularColor", &assimp_lights[i]->mColorSpecular, 1);
-            set_xyz(*matlab_lights, i, "position", &assimp_lights[i]->mPosition, 1);
-            set_xyz(*matlab_lights, i, "lookAtDirection", &assimp_lights[i]->mDirection, 1);
-            set_string(*matlab_lights, i, "name", &assimp_lights[i]->mName);
-            set_c_string(*matlab_lights, i, "type", light_type_string(assimp_lights[i]->mType));
-            set_scalar(*matlab_lights, i, "innerConeAngle", assimp_lights[i]->mAngleInnerCone);
-            set_scalar(*matlab_lights, i, "outerConeAngle", assimp_lights[i]->mAngleOuterCone);
-            set_scalar(*matlab_lights, i, "constantAttenuation", assimp_lights[i]->mAttenuationConstant);
-            set_scalar(*matlab_lights, i, "linearAttenuation", assimp_lights[i]->mAttenuationLinear);
-            set_scalar(*matlab_lights, i, "quadraticAttenuation", assimp_lights[i]->mAttenuationQuadratic);
+            set_rgb(*matlab_lights, i, ambient_color_field, &assimp_lights[i]->mColorAmbient, 1);
+            set_rgb(*matlab_lights, i, diffuse_color_field, &assimp_lights[i]->mColorDiffuse, 1);
+            set_rgb(*matlab_lights, i, specular_color_field, &assimp_lights[i]->mColorSpecular, 1);
+            set_xyz(*matlab_lights, i, position_field, &assimp_lights[i]->mPosition, 1);
+            set_xyz(*matlab_lights, i, look_at_direction_field, &assimp_lights[i]->mDirection, 1);
+            set_string(*matlab_lights, i, name_field, &assimp_lights[i]->mName);
+            set_c_string(*matlab_lights, i, type_field, light_type_string(assimp_lights[i]->mType));
+            set_scalar(*matlab_lights, i, inner_cone_angle_field, assimp_lights[i]->mAngleInnerCone);
+            set_scalar(*matlab_lights, i, outer_cone_angle_field, assimp_lights[i]->mAngleOuterCone);
+            set_scalar(*matlab_lights, i, constant_attenuation_field, assimp_lights[i]->mAttenuationConstant);
+            set_scalar(*matlab_lights, i, linear_attenuation_field, assimp_lights[i]->mAttenuationLinear);
+            set_scalar(*matlab_lights, i, quadratic_attenuation_field, assimp_lights[i]->mAttenuationQuadratic);
         }
         
         return num_lights;
@@ -215,7 +306,7 @@ namespace mexximp {
     
     // materials
     
-    unsigned to_assimp_materials(const mxArray* matlab_materials, aiMaterial*** assimp_materials) {
+    unsigned to_assimp_materials(const mxArray* matlab_materials, aiMaterial*** assimp_materials, arena* scene_arena) {
         if (!matlab_materials || !assimp_materials || !mxIsStruct(matlab_materials)) {
             return 0;
         }
@@ -226,17 +317,21 @@ namespace mexximp {
             return 0;
         }
         
+        const int properties_field = field_number(matlab_materials, "properties");
+        
         for (unsigned i = 0; i < num_materials; i++) {
             (*assimp_materials)[i] = new aiMaterial();
             
             // get 5 properties by default, we will allocate our own below
             (*assimp_materials)[i]->Clear();
             delete[] (*assimp_materials)[i]->mProperties;
+            (*assimp_materials)[i]->mProperties = 0;
             
-            mxArray* matlab_properties = mxGetField(matlab_materials, i, "properties");
+            mxArray* matlab_properties = get_field(matlab_materials, i, properties_field);
             unsigned num_properties = to_assimp_material_properties(
                     matlab_properties,
-                    &(*assimp_materials)[i]->mProperties);
+                    &(*assimp_materials)[i]->mProperties,
+                    scene_arena);
             (*assimp_materials)[i]->mNumAllocated = num_properties;
             (*assimp_materials)[i]->mNumProperties = num_properties;
         }
@@ -260,13 +355,15 @@ namespace mexximp {
                 COUNT(material_field_names),
                 &material_field_names[0]);
         
+        const int properties_field = field_number(*matlab_materials, "properties");
+        
         for (unsigned i = 0; i < num_materials; i++) {
             mxArray* matlab_properties;
             to_matlab_material_properties(assimp_materials[i]->mProperties,
                     &matlab_properties,
                     assimp_materials[i]->mNumProperties);
             if (matlab_properties) {
-                mxSetField(*matlab_materials, i, "properties", matlab_properties);
+                set_field(*matlab_materials, i, properties_field, matlab_properties);
             }
         }
         
@@ -275,7 +372,7 @@ namespace mexximp {
     
     // material properties
     
-    unsigned to_assimp_material_properties(const mxArray* matlab_properties, aiMaterialProperty*** assimp_properties) {
+    unsigned to_assimp_material_properties(const mxArray* matlab_properties, aiMaterialProperty*** assimp_properties, arena* scene_arena) {
         if (!matlab_properties || !assimp_properties || !mxIsStruct(matlab_properties)) {
             return 0;
         }
@@ -285,24 +382,37 @@ namespace mexximp {
             return 0;
         }
         
-        *assimp_properties = new aiMaterialProperty*[num_properties];
+        // with an arena, the pointers and all the properties are one allocation each
+        aiMaterialProperty* arena_properties = 0;
+        if (scene_arena) {
+            *assimp_properties = scene_arena->allocate_array<aiMaterialProperty*>(num_properties);
+            arena_properties = scene_arena->allocate_array<aiMaterialProperty>(num_properties);
+        } else {
+            *assimp_properties = new aiMaterialProperty*[num_properties];
+        }
         if (!*assimp_properties) {
             return 0;
         }
         
+        const int key_field = field_number(matlab_properties, "key");
+        const int texture_index_field = field_number(matlab_properties, "textureIndex");
+        const int texture_semantic_field = field_number(matlab_properties, "textureSemantic");
+        const int data_type_field = field_number(matlab_properties, "dataType");
+        const int data_field = field_number(matlab_properties, "data");
+        
         for (unsigned i = 0; i < num_properties; i++) {
-            (*assimp_properties)[i] = new aiMaterialProperty();
+            (*assimp_properties)[i] = arena_properties ? &arena_properties[i] : new aiMaterialProperty();
             
-            (*assimp_properties)[i]->mKey.Set(ugly_key(get_c_string(matlab_properties, i, "key", "property")));
+            (*assimp_properties)[i]->mKey.Set(ugly_key(get_c_string(matlab_properties, i, key_field, "property")));
             
-            (*assimp_properties)[i]->mIndex = get_scalar(matlab_properties, i, "textureIndex", 0);
-            (*assimp_properties)[i]->mSemantic = texture_type_code(get_c_string(matlab_properties, i, "textureSemantic", "unknown"));
+            (*assimp_properties)[i]->mIndex = get_scalar(matlab_properties, i, texture_index_field, 0);
+            (*assimp_properties)[i]->mSemantic = texture_type_code(get_c_string(matlab_properties, i, texture_semantic_field, "unknown"));
             
-            aiPropertyTypeInfo type_code = material_property_type_code(get_c_string(matlab_properties, i, "dataType", "buffer"));
+            aiPropertyTypeInfo type_code = material_property_type_code(get_c_string(matlab_properties, i, data_type_field, "buffer"));
             (*assimp_properties)[i]->mType = type_code;
             
             unsigned num_bytes;
-            (*assimp_properties)[i]->mData = get_property_data(matlab_properties, i, "data", type_code, &num_bytes);
+            (*assimp_properties)[i]->mData = get_property_data(matlab_properties, i, data_field, type_code, &num_bytes, scene_arena);
             (*assimp_properties)[i]->mDataLength = num_bytes;
         }
         
@@ -325,14 +435,20 @@ namespace mexximp {
                 COUNT(material_property_field_names),
                 &material_property_field_names[0]);
         
+        const int key_field = field_number(*matlab_properties, "key");
+        const int texture_index_field = field_number(*matlab_properties, "textureIndex");
+        const int texture_semantic_field = field_number(*matlab_properties, "textureSemantic");
+        const int data_type_field = field_number(*matlab_properties, "dataType");
+        const int data_field = field_number(*matlab_properties, "data");
+        
         for (unsigned i = 0; i < num_properties; i++) {
-            set_c_string(*matlab_properties, i, "key", nice_key(assimp_properties[i]->mKey.C_Str()));
-            set_scalar(*matlab_properties, i, "textureIndex", assimp_properties[i]->mIndex);
-            set_c_string(*matlab_properties, i, "textureSemantic", texture_type_string((aiTextureType)assimp_properties[i]->mSemantic));
+            set_c_string(*matlab_properties, i, key_field, nice_key(assimp_properties[i]->mKey.C_Str()));
+            set_scalar(*matlab_properties, i, texture_index_field, assimp_properties[i]->mIndex);
+            set_c_string(*matlab_properties, i, texture_semantic_field, texture_type_string((aiTextureType)assimp_properties[i]->mSemantic));
             
             aiPropertyTypeInfo type_code = assimp_properties[i]->mType;
-            set_c_string(*matlab_properties, i, "dataType", material_property_type_string(type_code));
-            set_property_data(*matlab_properties, i, "data", assimp_properties[i]->mData,  type_code, assimp_properties[i]->mDataLength);
+            set_c_string(*matlab_properties, i, data_type_field, material_property_type_string(type_code));
+            set_property_data(*matlab_properties, i, data_field, assimp_properties[i]->mData,  type_code, assimp_properties[i]->mDataLength);
         }
         
         return num_properties;
@@ -340,7 +456,149 @@ namespace mexximp {
     
     // meshes
     
-    unsigned to_assimp_meshes(const mxArray* matlab_meshes, aiMesh*** assimp_meshes) {
+    // Mesh data fills that don't touch the mx API, so they can run on worker threads.
+    // The Matlab arrays they fill must be allocated first, on the Matlab thread.
+    typedef std::function<void()> fill_job;
+    
+    // float channels like vertices and colors, as num_rows x num_columns double or single
+    static void queue_floats(mxArray* matlab_struct, unsigned index, int field_number, const float* floats, unsigned num_rows, unsigned num_columns, bool single_precision, std::vector<fill_job>* fills) {
+        if (0 > field_number) {
+            return;
+        }
+        
+        mxClassID class_id = single_precision ? mxSINGLE_CLASS : mxDOUBLE_CLASS;
+        if (!floats || 0 == num_columns) {
+            set_field(matlab_struct, index, field_number, mxCreateNumericMatrix(num_rows, 0, class_id, mxREAL));
+            return;
+        }
+        
+        mxArray* matlab_floats = mxCreateUninitNumericMatrix(num_rows, num_columns, class_id, mxREAL);
+        void* matlab_data = mxGetData(matlab_floats);
+        set_field(matlab_struct, index, field_number, matlab_floats);
+        if (!matlab_data) {
+            return;
+        }
+        
+        size_t num_elements = (size_t)num_rows * num_columns;
+        if (single_precision) {
+            fills->push_back([=]() {
+                memcpy(matlab_data, floats, num_elements * sizeof(float));
+            });
+        } else {
+            fills->push_back([=]() {
+                widen_floats(floats, (double*)matlab_data, num_elements);
+            });
+        }
+    }
+    
+    // box around vertices as [xmin xmax; ymin ymax; zmin zmax], or [] if no vertices
+    static void queue_bounds(mxArray* matlab_struct, unsigned index, int field_number, const aiVector3D* vertices, unsigned num_vertices, std::vector<fill_job>* fills) {
+        if (0 > field_number) {
+            return;
+        }
+        
+        if (!vertices || 0 == num_vertices) {
+            set_field(matlab_struct, index, field_number, emptyDouble());
+            return;
+        }
+        
+        mxArray* matlab_bounds = mxCreateDoubleMatrix(3, 2, mxREAL);
+        double* bounds = mxGetPr(matlab_bounds);
+        set_field(matlab_struct, index, field_number, matlab_bounds);
+        if (!bounds) {
+            return;
+        }
+        
+        fills->push_back([=]() {
+            float mins[3], maxes[3];
+            bound_xyz((const float*)vertices, num_vertices, mins, maxes);
+            for (unsigned c = 0; c < 3; c++) {
+                bounds[c] = mins[c];
+                bounds[c + 3] = maxes[c];
+            }
+        });
+    }
+    
+    static unsigned queue_packed_faces(aiFace* assimp_faces, mxArray** matlab_faces, unsigned num_faces, std::vector<fill_job>* fills);
+    
+    // Mesh data read from Matlab on the Matlab thread, so Assimp arrays can be built on worker threads.
+    
+    // float channels like vertices and colors, from double or single
+    struct float_source {
+        const void* data;
+        bool is_single;
+        bool is_packed;
+        unsigned num_vectors;
+        
+        float_source() : data(0), is_single(false), is_packed(false), num_vectors(0) {}
+    };
+    
+    static float_source read_floats(const mxArray* matlab_floats, unsigned num_components) {
+        float_source source;
+        if (!matlab_floats || !(mxIsDouble(matlab_floats) || mxIsSingle(matlab_floats))) {
+            return source;
+        }
+        
+        source.data = mxGetData(matlab_floats);
+        if (!source.data) {
+            return source;
+        }
+        
+        source.is_single = mxIsSingle(matlab_floats);
+        source.is_packed = num_components == mxGetM(matlab_floats) && !mxIsComplex(matlab_floats);
+        source.num_vectors = mxGetNumberOfElements(matlab_floats) / num_components;
+        return source;
+    }
+    
+    // T is a packed float type like aiVector3D or aiColor4D
+    // single data with one column per vector already has the Assimp layout, so it can be borrowed as-is
+    template <typename T>
+    static T* build_floats(const float_source& source, bool borrow_singles) {
+        if (!source.data) {
+            return 0;
+        }
+        
+        if (borrow_singles && source.is_single && source.is_packed) {
+            return (T*)source.data;
+        }
+        
+        T* target = new T[source.num_vectors];
+        if (source.is_single) {
+            memcpy((void*)target, source.data, source.num_vectors * sizeof(T));
+        } else {
+            narrow_doubles((const double*)source.data, (float*)target, source.num_vectors * sizeof(T) / sizeof(float));
+        }
+        return target;
+    }
+    
+    // packed faces as indices of any numeric type, with offsets copied from Matlab
+    struct packed_face_source {
+        const void* indices;
+        mxClassID class_id;
+        uint32_T* offsets;
+        unsigned num_faces;
+        
+        packed_face_source() : indices(0), class_id(mxUNKNOWN_CLASS), offsets(0), num_faces(0) {}
+    };
+    
+    static bool is_packed_faces(const mxArray* matlab_faces) {
+        return mxIsNumeric(matlab_faces) || (mxIsStruct(matlab_faces) && mxGetField(matlab_faces, 0, "faceOffsets"));
+    }
+    
+    static bool read_packed_faces(const mxArray* matlab_faces, packed_face_source* source);
+    static unsigned build_packed_faces(packed_face_source* source, aiFace** assimp_faces, arena* scene_arena);
+    
+    struct mesh_source {
+        float_source vertices;
+        float_source bitangents;
+        float_source normals;
+        float_source tangents;
+        float_source colors[AI_MAX_NUMBER_OF_COLOR_SETS];
+        float_source texture_coordinates[AI_MAX_NUMBER_OF_TEXTURECOORDS];
+        packed_face_source packed_faces;
+    };
+    
+    unsigned to_assimp_meshes(const mxArray* matlab_meshes, aiMesh*** assimp_meshes, const export_options& options, arena* scene_arena) {
         if (!matlab_meshes || !assimp_meshes || !mxIsStruct(matlab_meshes)) {
             return 0;
         }
@@ -351,111 +609,326 @@ namespace mexximp {
             return 0;
         }
         
+        const int name_field = field_number(matlab_meshes, "name");
+        const int material_index_field = field_number(matlab_meshes, "materialIndex");
+        const int vertices_field = field_number(matlab_meshes, "vertices");
+        const int bitangents_field = field_number(matlab_meshes, "bitangents");
+        const int normals_field = field_number(matlab_meshes, "normals");
+        const int tangents_field = field_number(matlab_meshes, "tangents");
+        const int primitive_types_field = field_number(matlab_meshes, "primitiveTypes");
+        const int faces_field = field_number(matlab_meshes, "faces");
+        
+        int colors_fields[AI_MAX_NUMBER_OF_COLOR_SETS];
+        for (unsigned c = 0; c < AI_MAX_NUMBER_OF_COLOR_SETS; c++) {
+            colors_fields[c] = field_number(matlab_meshes, mesh_colors_field_names[c]);
+        }
+        
+        int texture_coordinates_fields[AI_MAX_NUMBER_OF_TEXTURECOORDS];
+        for (unsigned t = 0; t < AI_MAX_NUMBER_OF_TEXTURECOORDS; t++) {
+            texture_coordinates_fields[t] = field_number(matlab_meshes, mesh_texture_coordinates_field_names[t]);
+        }
+        
+        // read everything here on the Matlab thread, build arrays and faces for each mesh on worker threads
+        std::vector<mesh_source> sources(num_meshes);
         for (unsigned i = 0; i < num_meshes; i++) {
-            (*assimp_meshes)[i] = new aiMesh();
-            
-            get_string(matlab_meshes, i, "name", &(*assimp_meshes)[i]->mName, "mesh");
-            (*assimp_meshes)[i]->mMaterialIndex = get_scalar(matlab_meshes, i, "materialIndex", 0);
-            (*assimp_meshes)[i]->mVertices = get_xyz(matlab_meshes, i, "vertices", &(*assimp_meshes)[i]->mNumVertices);
-            (*assimp_meshes)[i]->mBitangents = get_xyz(matlab_meshes, i, "bitangents", 0);
-            (*assimp_meshes)[i]->mNormals = get_xyz(matlab_meshes, i, "normals", 0);
-            (*assimp_meshes)[i]->mTangents = get_xyz(matlab_meshes, i, "tangents", 0);
-            (*assimp_meshes)[i]->mPrimitiveTypes = mesh_primitive_codes(mxGetField(matlab_meshes, i, "primitiveTypes"));
-            
-            (*assimp_meshes)[i]->mColors[0] = get_rgba(matlab_meshes, i, "colors0", 0);
-            (*assimp_meshes)[i]->mColors[1] = get_rgba(matlab_meshes, i, "colors1", 0);
-            (*assimp_meshes)[i]->mColors[2] = get_rgba(matlab_meshes, i, "colors2", 0);
-            (*assimp_meshes)[i]->mColors[3] = get_rgba(matlab_meshes, i, "colors3", 0);
-            (*assimp_meshes)[i]->mColors[4] = get_rgba(matlab_meshes, i, "colors4", 0);
-            (*assimp_meshes)[i]->mColors[5] = get_rgba(matlab_meshes, i, "colors5", 0);
-            (*assimp_meshes)[i]->mColors[6] = get_rgba(matlab_meshes, i, "colors6", 0);
-            (*assimp_meshes)[i]->mColors[7] = get_rgba(matlab_meshes, i, "colors7", 0);
-            
-            (*assimp_meshes)[i]->mTextureCoords[0] = get_xyz(matlab_meshes, i, "textureCoordinates0", 0);
-            (*assimp_meshes)[i]->mTextureCoords[1] = get_xyz(matlab_meshes, i, "textureCoordinates1", 0);
-            (*assimp_meshes)[i]->mTextureCoords[2] = get_xyz(matlab_meshes, i, "textureCoordinates2", 0);
-            (*assimp_meshes)[i]->mTextureCoords[3] = get_xyz(matlab_meshes, i, "textureCoordinates3", 0);
-            (*assimp_meshes)[i]->mTextureCoords[4] = get_xyz(matlab_meshes, i, "textureCoordinates4", 0);
-            (*assimp_meshes)[i]->mTextureCoords[5] = get_xyz(matlab_meshes, i, "textureCoordinates5", 0);
-            (*assimp_meshes)[i]->mTextureCoords[6] = get_xyz(matlab_meshes, i, "textureCoordinates6", 0);
-            (*assimp_meshes)[i]->mTextureCoords[7] = get_xyz(matlab_meshes, i, "textureCoordinates7", 0);
-            
-            mxArray* matlab_faces = mxGetField(matlab_meshes, i, "faces");
-            (*assimp_meshes)[i]->mNumFaces = to_assimp_faces(matlab_faces, &(*assimp_meshes)[i]->mFaces);
+            aiMesh* mesh = new aiMesh();
+            (*assimp_meshes)[i] = mesh;
+            
+            get_string(matlab_meshes, i, name_field, &mesh->mName, "mesh");
+            mesh->mMaterialIndex = get_scalar(matlab_meshes, i, material_index_field, 0);
+            mesh->mPrimitiveTypes = mesh_primitive_codes(get_field(matlab_meshes, i, primitive_types_field));
+            
+            mesh_source& source = sources[i];
+            source.vertices = read_floats(get_field(matlab_meshes, i, vertices_field), 3);
+            source.bitangents = read_floats(get_field(matlab_meshes, i, bitangents_field), 3);
+            source.normals = read_floats(get_field(matlab_meshes, i, normals_field), 3);
+            source.tangents = read_floats(get_field(matlab_meshes, i, tangents_field), 3);
+            
+            for (unsigned c = 0; c < AI_MAX_NUMBER_OF_COLOR_SETS; c++) {
+                source.colors[c] = read_floats(get_field(matlab_meshes, i, colors_fields[c]), 4);
+            }
+            
+            for (unsigned t = 0; t < AI_MAX_NUMBER_OF_TEXTURECOORDS; t++) {
+                source.texture_coordinates[t] = read_floats(get_field(matlab_meshes, i, texture_coordinates_fields[t]), 3);
+            }
+            
+            // a struct per face has to be read one face at a time, right here
+            mxArray* matlab_faces = get_field(matlab_meshes, i, faces_field);
+            if (matlab_faces && is_packed_faces(matlab_faces)) {
+                if (!read_packed_faces(matlab_faces, &source.packed_faces)) {
+                    mexPrintf("Skipping faces of mesh %d, packed faces need whole, non-negative indices and offsets of class uint32, int32, single, or double.\n", i + 1);
+                }
+            } else {
+                mesh->mNumFaces = to_assimp_faces(matlab_faces, &mesh->mFaces, scene_arena);
+            }
         }
         
+        parallel_for(num_meshes, options.num_threads, [&](size_t i) {
+            aiMesh* mesh = (*assimp_meshes)[i];
+            mesh_source& source = sources[i];
+            
+            mesh->mVertices = build_floats<aiVector3D>(source.vertices, options.borrow_singles);
+            mesh->mNumVertices = source.vertices.num_vectors;
+            mesh->mBitangents = build_floats<aiVector3D>(source.bitangents, options.borrow_singles);
+            mesh->mNormals = build_floats<aiVector3D>(source.normals, options.borrow_singles);
+            mesh->mTangents = build_floats<aiVector3D>(source.tangents, options.borrow_singles);
+            
+            for (unsigned c = 0; c < AI_MAX_NUMBER_OF_COLOR_SETS; c++) {
+                mesh->mColors[c] = build_floats<aiColor4D>(source.colors[c], options.borrow_singles);
+            }
+            
+            for (unsigned t = 0; t < AI_MAX_NUMBER_OF_TEXTURECOORDS; t++) {
+                mesh->mTextureCoords[t] = build_floats<aiVector3D>(source.texture_coordinates[t], options.borrow_singles);
+            }
+            
+            if (source.packed_faces.offsets) {
+                mesh->mNumFaces = build_packed_faces(&source.packed_faces, &mesh->mFaces, scene_arena);
+            }
+        });
+        
         return num_meshes;
     }
     
-    unsigned to_matlab_meshes(aiMesh** assimp_meshes, mxArray** matlab_meshes, unsigned num_meshes) {
+    template <typename T>
+    static void detach_borrowed_floats(const mxArray* matlab_meshes, unsigned index, int field, T** assimp_floats) {
+        const mxArray* matlab_floats = get_field(matlab_meshes, index, field);
+        if (matlab_floats && *assimp_floats && (const void*)*assimp_floats == mxGetData(matlab_floats)) {
+            *assimp_floats = 0;
+        }
+    }
+    
+    void detach_borrowed_buffers(const mxArray* matlab_scene, aiScene* assimp_scene) {
+        if (!matlab_scene || !assimp_scene || !assimp_scene->mMeshes || !mxIsStruct(matlab_scene)) {
+            return;
+        }
+        
+        const mxArray* matlab_meshes = mxGetField(matlab_scene, 0, "meshes");
+        if (!matlab_meshes || !mxIsStruct(matlab_meshes)) {
+            return;
+        }
+        
+        const int vertices_field = field_number(matlab_meshes, "vertices");
+        const int bitangents_field = field_number(matlab_meshes, "bitangents");
+        const int normals_field = field_number(matlab_meshes, "normals");
+        const int tangents_field = field_number(matlab_meshes, "tangents");
+        
+        int colors_fields[AI_MAX_NUMBER_OF_COLOR_SETS];
+        for (unsigned c = 0; c < AI_MAX_NUMBER_OF_COLOR_SETS; c++) {
+            colors_fields[c] = field_number(matlab_meshes, mesh_colors_field_names[c]);
+        }
+        
+        int texture_coordinates_fields[AI_MAX_NUMBER_OF_TEXTURECOORDS];
+        for (unsigned t = 0; t < AI_MAX_NUMBER_OF_TEXTURECOORDS; t++) {
+            texture_coordinates_fields[t] = field_number(matlab_meshes, mesh_texture_coordinates_field_names[t]);
+        }
+        
+        // Assimp meshes were built in the same order as the Matlab meshes
+        unsigned num_meshes = mxGetNumberOfElements(matlab_meshes);
+        if (num_meshes > assimp_scene->mNumMeshes) {
+            num_meshes = assimp_scene->mNumMeshes;
+        }
+        for (unsigned i = 0; i < num_meshes; i++) {
+            aiMesh* mesh = assimp_scene->mMeshes[i];
+            if (!mesh) {
+                continue;
+            }
+            
+            detach_borrowed_floats(matlab_meshes, i, vertices_field, &mesh->mVertices);
+            detach_borrowed_floats(matlab_meshes, i, bitangents_field, &mesh->mBitangents);
+            detach_borrowed_floats(matlab_meshes, i, normals_field, &mesh->mNormals);
+            detach_borrowed_floats(matlab_meshes, i, tangents_field, &mesh->mTangents);
+            
+            for (unsigned c = 0; c < AI_MAX_NUMBER_OF_COLOR_SETS; c++) {
+                detach_borrowed_floats(matlab_meshes, i, colors_fields[c], &mesh->mColors[c]);
+            }
+            
+            for (unsigned t = 0; t < AI_MAX_NUMBER_OF_TEXTURECOORDS; t++) {
+                detach_borrowed_floats(matlab_meshes, i, texture_coordinates_fields[t], &mesh->mTextureCoords[t]);
+            }
+        }
+    }
+    
+    unsigned to_matlab_meshes(aiMesh** assimp_meshes, mxArray** matlab_meshes, unsigned num_meshes, const import_options& options, timing_report* timing) {
         if (!matlab_meshes) {
             return 0;
         }
         
+        // faces are timed separately, then left out of the meshes phase
+        phase_timer meshes_timer;
+        phase_timer faces_timer;
+        double num_faces = 0;
+        double faces_bytes = 0;
+        if (timing) {
+            meshes_timer.start();
+        }
+        
         if (!assimp_meshes || 0 == num_meshes) {
             *matlab_meshes = emptyDouble();
+            if (timing) {
+                meshes_timer.stop();
+                timing->add("meshes", meshes_timer, 0, 0);
+                timing->add("faces", faces_timer, 0, 0);
+            }
             return 0;
         }
         
+        // fields that weren't selected are never converted or allocated
+        const char* field_names[COUNT(mesh_field_names) + 1];
+        unsigned num_fields = 0;
+        for (unsigned i = 0; i < COUNT(mesh_field_names); i++) {
+            if (((options.mesh_fields | mesh_required_fields) >> i) & 1) {
+                field_names[num_fields++] = mesh_field_names[i];
+            }
+        }
+        if (options.mesh_bounds) {
+            field_names[num_fields++] = "bounds";
+        }
+        
         *matlab_meshes = mxCreateStructMatrix(
                 1,
                 num_meshes,
-                COUNT(mesh_field_names),
-                &mesh_field_names[0]);
+                num_fields,
+                &field_names[0]);
+        
+        const int name_field = field_number(*matlab_meshes, "name");
+        const int material_index_field = field_number(*matlab_meshes, "materialIndex");
+        const int vertices_field = field_number(*matlab_meshes, "vertices");
+        const int bitangents_field = field_number(*matlab_meshes, "bitangents");
+        const int normals_field = field_number(*matlab_meshes, "normals");
+        const int tangents_field = field_number(*matlab_meshes, "tangents");
+        const int primitive_types_field = field_number(*matlab_meshes, "primitiveTypes");
+        const int faces_field = field_number(*matlab_meshes, "faces");
+        const int bounds_field = field_number(*matlab_meshes, "bounds");
+        
+        int colors_fields[AI_MAX_NUMBER_OF_COLOR_SETS];
+        for (unsigned c = 0; c < AI_MAX_NUMBER_OF_COLOR_SETS; c++) {
+            colors_fields[c] = field_number(*matlab_meshes, mesh_colors_field_names[c]);
+        }
+        
+        int texture_coordinates_fields[AI_MAX_NUMBER_OF_TEXTURECOORDS];
+        for (unsigned t = 0; t < AI_MAX_NUMBER_OF_TEXTURECOORDS; t++) {
+            texture_coordinates_fields[t] = field_number(*matlab_meshes, mesh_texture_coordinates_field_names[t]);
+        }
         
+        // allocate everything here on the Matlab thread, queue up bulk fills for worker threads
+        std::vector<fill_job> fills;
+        std::vector<fill_job> face_fills;
         for (unsigned i = 0; i < num_meshes; i++) {
-            set_string(*matlab_meshes, i, "name", &assimp_meshes[i]->mName);
-            set_scalar(*matlab_meshes, i, "materialIndex", assimp_meshes[i]->mMaterialIndex);
-            set_xyz(*matlab_meshes, i, "vertices", assimp_meshes[i]->mVertices, assimp_meshes[i]->mNumVertices);
-            set_xyz(*matlab_meshes, i, "bitangents", assimp_meshes[i]->mBitangents, assimp_meshes[i]->mNumVertices);
-            set_xyz(*matlab_meshes, i, "normals", assimp_meshes[i]->mNormals, assimp_meshes[i]->mNumVertices);
-            set_xyz(*matlab_meshes, i, "tangents", assimp_meshes[i]->mTangents, assimp_meshes[i]->mNumVertices);
-            mxSetField(*matlab_meshes, i, "primitiveTypes", mesh_primitive_struct(assimp_meshes[i]->mPrimitiveTypes));
-            
-            set_rgba(*matlab_meshes, i, "colors0", assimp_meshes[i]->mColors[0], assimp_meshes[i]->mNumVertices);
-            set_rgba(*matlab_meshes, i, "colors1", assimp_meshes[i]->mColors[1], assimp_meshes[i]->mNumVertices);
-            set_rgba(*matlab_meshes, i, "colors2", assimp_meshes[i]->mColors[2], assimp_meshes[i]->mNumVertices);
-            set_rgba(*matlab_meshes, i, "colors3", assimp_meshes[i]->mColors[3], assimp_meshes[i]->mNumVertices);
-            set_rgba(*matlab_meshes, i, "colors4", assimp_meshes[i]->mColors[4], assimp_meshes[i]->mNumVertices);
-            set_rgba(*matlab_meshes, i, "colors5", assimp_meshes[i]->mColors[5], assimp_meshes[i]->mNumVertices);
-            set_rgba(*matlab_meshes, i, "colors6", assimp_meshes[i]->mColors[6], assimp_meshes[i]->mNumVertices);
-            set_rgba(*matlab_meshes, i, "colors7", assimp_meshes[i]->mColors[7], assimp_meshes[i]->mNumVertices);
-            
-            set_xyz(*matlab_meshes, i, "textureCoordinates0", assimp_meshes[i]->mTextureCoords[0], assimp_meshes[i]->mNumVertices);
-            set_xyz(*matlab_meshes, i, "textureCoordinates1", assimp_meshes[i]->mTextureCoords[1], assimp_meshes[i]->mNumVertices);
-            set_xyz(*matlab_meshes, i, "textureCoordinates2", assimp_meshes[i]->mTextureCoords[2], assimp_meshes[i]->mNumVertices);
-            set_xyz(*matlab_meshes, i, "textureCoordinates3", assimp_meshes[i]->mTextureCoords[3], assimp_meshes[i]->mNumVertices);
-            set_xyz(*matlab_meshes, i, "textureCoordinates4", assimp_meshes[i]->mTextureCoords[4], assimp_meshes[i]->mNumVertices);
-            set_xyz(*matlab_meshes, i, "textureCoordinates5", assimp_meshes[i]->mTextureCoords[5], assimp_meshes[i]->mNumVertices);
-            set_xyz(*matlab_meshes, i, "textureCoordinates6", assimp_meshes[i]->mTextureCoords[6], assimp_meshes[i]->mNumVertices);
-            set_xyz(*matlab_meshes, i, "textureCoordinates7", assimp_meshes[i]->mTextureCoords[7], assimp_meshes[i]->mNumVertices);
+            const aiMesh* mesh = assimp_meshes[i];
+            set_string(*matlab_meshes, i, name_field, &mesh->mName);
+            set_scalar(*matlab_meshes, i, material_index_field, mesh->mMaterialIndex);
+            queue_floats(*matlab_meshes, i, vertices_field, (const float*)mesh->mVertices, 3, mesh->mNumVertices, options.single_precision, &fills);
+            queue_floats(*matlab_meshes, i, bitangents_field, (const float*)mesh->mBitangents, 3, mesh->mNumVertices, options.single_precision, &fills);
+            queue_floats(*matlab_meshes, i, normals_field, (const float*)mesh->mNormals, 3, mesh->mNumVertices, options.single_precision, &fills);
+            queue_floats(*matlab_meshes, i, tangents_field, (const float*)mesh->mTangents, 3, mesh->mNumVertices, options.single_precision, &fills);
+            set_field(*matlab_meshes, i, primitive_types_field, mesh_primitive_struct(mesh->mPrimitiveTypes));
             
+            for (unsigned c = 0; c < AI_MAX_NUMBER_OF_COLOR_SETS; c++) {
+                queue_floats(*matlab_meshes, i, colors_fields[c], (const float*)mesh->mColors[c], 4, mesh->mNumVertices, options.single_precision, &fills);
+            }
+            
+            for (unsigned t = 0; t < AI_MAX_NUMBER_OF_TEXTURECOORDS; t++) {
+                queue_floats(*matlab_meshes, i, texture_coordinates_fields[t], (const float*)mesh->mTextureCoords[t], 3, mesh->mNumVertices, options.single_precision, &fills);
+            }
+            
+            queue_bounds(*matlab_meshes, i, bounds_field, mesh->mVertices, mesh->mNumVertices, &fills);
+            
+            if (0 > faces_field) {
+                continue;
+            }
+            
+            if (timing) {
+                faces_timer.start();
+            }
             mxArray* matlab_faces;
-            to_matlab_faces(assimp_meshes[i]->mFaces, &matlab_faces, assimp_meshes[i]->mNumFaces);
+            if (options.packed_faces) {
+                queue_packed_faces(mesh->mFaces, &matlab_faces, mesh->mNumFaces, &face_fills);
+            } else {
+                to_matlab_faces(mesh->mFaces, &matlab_faces, mesh->mNumFaces);
+            }
             if (matlab_faces) {
-                mxSetField(*matlab_meshes, i, "faces", matlab_faces);
+                set_field(*matlab_meshes, i, faces_field, matlab_faces);
+            }
+            if (timing) {
+                faces_timer.stop();
+                num_faces += mesh->mNumFaces;
+                faces_bytes += array_bytes(matlab_faces);
             }
         }
         
+        run_jobs(fills, options.num_threads);
+        
+        if (timing) {
+            faces_timer.start();
+        }
+        run_jobs(face_fills, options.num_threads);
+        
+        if (timing) {
+            faces_timer.stop();
+            meshes_timer.stop();
+            
+            // clock ticks are coarse, so don't let the difference go negative
+            meshes_timer.wall_seconds = std::max(0.0, meshes_timer.wall_seconds - faces_timer.wall_seconds);
+            meshes_timer.cpu_seconds = std::max(0.0, meshes_timer.cpu_seconds - faces_timer.cpu_seconds);
+            timing->add("meshes", meshes_timer, num_meshes, array_bytes(*matlab_meshes) - faces_bytes);
+            timing->add("faces", faces_timer, num_faces, faces_bytes);
+        }
+        
         return num_meshes;
     }
     
     // mesh faces
     
-    unsigned to_assimp_faces(const mxArray* matlab_faces, aiFace** assimp_faces) {
-        if (!matlab_faces || !assimp_faces || !mxIsStruct(matlab_faces)) {
+    unsigned to_assimp_faces(const mxArray* matlab_faces, aiFace** assimp_faces, arena* scene_arena) {
+        if (!matlab_faces || !assimp_faces) {
+            return 0;
+        }
+        
+        // packed faces come as a numeric matrix or as offsets + indices
+        if (is_packed_faces(matlab_faces)) {
+            return to_assimp_packed_faces(matlab_faces, assimp_faces, scene_arena);
+        }
+        
+        if (!mxIsStruct(matlab_faces)) {
             return 0;
         }
         
         unsigned num_faces = mxGetNumberOfElements(matlab_faces);
-        *assimp_faces = new aiFace[num_faces];
+        *assimp_faces = scene_arena ? scene_arena->allocate_array<aiFace>(num_faces) : new aiFace[num_faces];
         if (!*assimp_faces) {
             return 0;
         }
         
+        const int indices_field = field_number(matlab_faces, "indices");
+        
+        if (scene_arena) {
+            // count all the indices, then copy them into one block
+            size_t num_indices = 0;
+            for (unsigned i = 0; i < num_faces; i++) {
+                const mxArray* matlab_indices = get_field(matlab_faces, i, indices_field);
+                if (matlab_indices && mxIsUint32(matlab_indices) && mxGetData(matlab_indices)) {
+                    num_indices += mxGetNumberOfElements(matlab_indices);
+                }
+            }
+            
+            unsigned* indices = (unsigned*)scene_arena->allocate(num_indices * sizeof(unsigned));
+            for (unsigned i = 0; i < num_faces; i++) {
+                const mxArray* matlab_indices = get_field(matlab_faces, i, indices_field);
+                if (!matlab_indices || !mxIsUint32(matlab_indices) || !mxGetData(matlab_indices)) {
+                    continue;
+                }
+                unsigned num_face_indices = mxGetNumberOfElements(matlab_indices);
+                memcpy(indices, mxGetData(matlab_indices), num_face_indices * sizeof(unsigned));
+                (*assimp_faces)[i].mIndices = indices;
+                (*assimp_faces)[i].mNumIndices = num_face_indices;
+                indices += num_face_indices;
+            }
+            return num_faces;
+        }
+        
         for (unsigned i = 0; i < num_faces; i++) {
             // ignore the nIndices passed from matlab -- it's just a convenience
-            (*assimp_faces)[i].mIndices = get_indices(matlab_faces, i, "indices", &(*assimp_faces)[i].mNumIndices);
+            (*assimp_faces)[i].mIndices = get_indices(matlab_faces, i, indices_field, &(*assimp_faces)[i].mNumIndices);
         }
         
         return num_faces;
@@ -477,34 +950,279 @@ namespace mexximp {
                 COUNT(face_field_names),
                 &face_field_names[0]);
         
+        const int n_indices_field = field_number(*matlab_faces, "nIndices");
+        const int indices_field = field_number(*matlab_faces, "indices");
+        
         for (unsigned i = 0; i < num_faces; i++) {
             // pass nIndices explicitly to matlab as a convenience
-            set_scalar(*matlab_faces, i, "nIndices", assimp_faces[i].mNumIndices);
-            set_indices(*matlab_faces, i, "indices", assimp_faces[i].mIndices, assimp_faces[i].mNumIndices);
+            set_scalar(*matlab_faces, i, n_indices_field, assimp_faces[i].mNumIndices);
+            set_indices(*matlab_faces, i, indices_field, assimp_faces[i].mIndices, assimp_faces[i].mNumIndices);
         }
         
         return num_faces;
     }
     
-    // node hierarchy
+    // copy packed indices of any numeric type into newed aiFace index arrays, or into one arena block laid out like the offsets
+    // read_packed_faces already checked that indices are whole and non-negative
+    template <typename T>
+    static void fill_faces(const T* indices, const uint32_T* offsets, aiFace* assimp_faces, unsigned num_faces, unsigned* index_block) {
+        for (unsigned i = 0; i < num_faces; i++) {
+            unsigned num_indices = offsets[i + 1] - offsets[i];
+            const T* face_indices = &indices[offsets[i]];
+            assimp_faces[i].mNumIndices = num_indices;
+            assimp_faces[i].mIndices = index_block ? &index_block[offsets[i]] : new unsigned[num_indices];
+            for (unsigned j = 0; j < num_indices; j++) {
+                assimp_faces[i].mIndices[j] = face_indices[j];
+            }
+        }
+    }
     
-    unsigned to_assimp_nodes(const mxArray* matlab_node, unsigned index, aiNode** assimp_node, aiNode* assimp_parent) {
-        if (!matlab_node || !assimp_node || !mxIsStruct(matlab_node)) {
+    // false for negative, fractional, or too-large values, otherwise copy them when there's a target
+    template <typename T>
+    static bool read_unsigned(const T* values, unsigned num_values, uint32_T* target) {
+        for (unsigned i = 0; i < num_values; i++) {
+            double value = values[i];
+            if (!(0 <= value && value <= 4294967295.0 && value == floor(value))) {
+                return false;
+            }
+            if (target) {
+                target[i] = (uint32_T)value;
+            }
+        }
+        return true;
+    }
+    
+    // packed indices and offsets may be uint32, int32, single, or double
+    static bool read_unsigned(const mxArray* matlab_values, unsigned num_values, uint32_T* target) {
+        const void* data = mxGetData(matlab_values);
+        switch (mxGetClassID(matlab_values)) {
+            case mxUINT32_CLASS:
+                return read_unsigned((const uint32_T*)data, num_values, target);
+            case mxINT32_CLASS:
+                return read_unsigned((const int32_T*)data, num_values, target);
+            case mxSINGLE_CLASS:
+                return read_unsigned((const float*)data, num_values, target);
+            case mxDOUBLE_CLASS:
+                return read_unsigned((const double*)data, num_values, target);
+            default:
+                return false;
+        }
+    }
+    
+    // validate packed faces and copy their offsets, leave the indices in place
+    // no faces is valid, and leaves source->offsets empty
+    static bool read_packed_faces(const mxArray* matlab_faces, packed_face_source* source) {
+        // numeric matrix has one column per face
+        // make offsets for it so both layouts take the same path
+        const mxArray* matlab_indices;
+        uint32_T* offsets;
+        unsigned num_faces;
+        if (mxIsNumeric(matlab_faces)) {
+            matlab_indices = matlab_faces;
+            unsigned face_size = mxGetM(matlab_faces);
+            num_faces = mxGetN(matlab_faces);
+            if (0 == num_faces || 0 == face_size) {
+                return true;
+            }
+            offsets = new uint32_T[num_faces + 1];
+            for (unsigned i = 0; i <= num_faces; i++) {
+                offsets[i] = face_size * i;
+            }
+            
+        } else if (mxIsStruct(matlab_faces)) {
+            matlab_indices = mxGetField(matlab_faces, 0, "faceIndices");
+            const mxArray* matlab_offsets = mxGetField(matlab_faces, 0, "faceOffsets");
+            if (!matlab_indices || !mxIsNumeric(matlab_indices)
+                    || !matlab_offsets || !mxIsNumeric(matlab_offsets)) {
+                return false;
+            }
+            if (mxGetNumberOfElements(matlab_offsets) < 2) {
+                return true;
+            }
+            num_faces = mxGetNumberOfElements(matlab_offsets) - 1;
+            offsets = new uint32_T[num_faces + 1];
+            if (!read_unsigned(matlab_offsets, num_faces + 1, offsets)) {
+                delete [] offsets;
+                return false;
+            }
+            
+        } else {
+            return false;
+        }
+        
+        // offsets must climb and stay within the given indices
+        unsigned num_indices = mxGetNumberOfElements(matlab_indices);
+        for (unsigned i = 0; i < num_faces; i++) {
+            if (offsets[i] > offsets[i + 1]) {
+                delete [] offsets;
+                return false;
+            }
+        }
+        if (offsets[num_faces] > num_indices) {
+            delete [] offsets;
+            return false;
+        }
+        
+        // indices are checked here, so fill_faces never casts a negative or fractional index
+        if (!read_unsigned(matlab_indices, offsets[num_faces], 0)) {
+            delete [] offsets;
+            return false;
+        }
+        
+        source->indices = mxGetData(matlab_indices);
+        source->class_id = mxGetClassID(matlab_indices);
+        source->offsets = offsets;
+        source->num_faces = num_faces;
+        return true;
+    }
+    
+    // build faces from validated packed faces, and free the copied offsets
+    static unsigned build_packed_faces(packed_face_source* source, aiFace** assimp_faces, arena* scene_arena) {
+        unsigned num_faces = source->num_faces;
+        unsigned* index_block = 0;
+        if (scene_arena) {
+            *assimp_faces = scene_arena->allocate_array<aiFace>(num_faces);
+            index_block = (unsigned*)scene_arena->allocate(source->offsets[num_faces] * sizeof(unsigned));
+        } else {
+            *assimp_faces = new aiFace[num_faces];
+        }
+        
+        switch (source->class_id) {
+            case mxUINT32_CLASS:
+                fill_faces((const uint32_T*)source->indices, source->offsets, *assimp_faces, num_faces, index_block);
+                break;
+            case mxINT32_CLASS:
+                fill_faces((const int32_T*)source->indices, source->offsets, *assimp_faces, num_faces, index_block);
+                break;
+            case mxSINGLE_CLASS:
+                fill_faces((const float*)source->indices, source->offsets, *assimp_faces, num_faces, index_block);
+                break;
+            default:
+                fill_faces((const double*)source->indices, source->offsets, *assimp_faces, num_faces, index_block);
+                break;
+        }
+        
+        delete [] source->offsets;
+        source->offsets = 0;
+        return num_faces;
+    }
+    
+    unsigned to_assimp_packed_faces(const mxArray* matlab_faces, aiFace** assimp_faces, arena* scene_arena) {
+        if (!matlab_faces || !assimp_faces) {
             return 0;
         }
         
+        packed_face_source source;
+        if (!read_packed_faces(matlab_faces, &source) || !source.offsets) {
+            return 0;
+        }
+        return build_packed_faces(&source, assimp_faces, scene_arena);
+    }
+    
+    // faces with the same number of indices pack into one matrix, one column per face
+    // mixed faces pack into compressed rows: faceIndices from faceOffsets(i) to faceOffsets(i+1)
+    static unsigned queue_packed_faces(aiFace* assimp_faces, mxArray** matlab_faces, unsigned num_faces, std::vector<fill_job>* fills) {
+        if (!matlab_faces) {
+            return 0;
+        }
+        
+        if (!assimp_faces || 0 == num_faces) {
+            *matlab_faces = mxCreateNumericMatrix(3, 0, mxUINT32_CLASS, mxREAL);
+            return 0;
+        }
+        
+        unsigned face_size = assimp_faces[0].mNumIndices;
+        unsigned num_indices = 0;
+        bool is_uniform = true;
+        for (unsigned i = 0; i < num_faces; i++) {
+            num_indices += assimp_faces[i].mNumIndices;
+            is_uniform = is_uniform && face_size == assimp_faces[i].mNumIndices;
+        }
+        
+        if (is_uniform) {
+            *matlab_faces = mxCreateUninitNumericMatrix(face_size, num_faces, mxUINT32_CLASS, mxREAL);
+            uint32_T* matlab_indices = (uint32_T*)mxGetData(*matlab_faces);
+            if (!matlab_indices) {
+                return 0;
+            }
+            
+            fills->push_back([=]() {
+                for (unsigned i = 0; i < num_faces; i++) {
+                    memcpy(&matlab_indices[face_size * i], assimp_faces[i].mIndices, face_size * sizeof(uint32_T));
+                }
+            });
+            
+            return num_faces;
+        }
+        
+        *matlab_faces = mxCreateStructMatrix(
+                1,
+                1,
+                COUNT(packed_face_field_names),
+                &packed_face_field_names[0]);
+        
+        mxArray* face_offsets = mxCreateUninitNumericMatrix(1, num_faces + 1, mxUINT32_CLASS, mxREAL);
+        mxArray* face_indices = mxCreateUninitNumericMatrix(1, num_indices, mxUINT32_CLASS, mxREAL);
+        uint32_T* matlab_offsets = (uint32_T*)mxGetData(face_offsets);
+        uint32_T* matlab_indices = (uint32_T*)mxGetData(face_indices);
+        mxSetField(*matlab_faces, 0, "faceOffsets", face_offsets);
+        mxSetField(*matlab_faces, 0, "faceIndices", face_indices);
+        if (!matlab_offsets || !matlab_indices) {
+            return 0;
+        }
+        
+        fills->push_back([=]() {
+            unsigned offset = 0;
+            for (unsigned i = 0; i < num_faces; i++) {
+                matlab_offsets[i] = offset;
+                memcpy(&matlab_indices[offset], assimp_faces[i].mIndices, assimp_faces[i].mNumIndices * sizeof(uint32_T));
+                offset += assimp_faces[i].mNumIndices;
+            }
+            matlab_offsets[num_faces] = offset;
+        });
+        
+        return num_faces;
+    }
+    
+    unsigned to_matlab_packed_faces(aiFace* assimp_faces, mxArray** matlab_faces, unsigned num_faces) {
+        std::vector<fill_job> fills;
+        unsigned num_packed = queue_packed_faces(assimp_faces, matlab_faces, num_faces, &fills);
+        run_jobs(fills, 1);
+        return num_packed;
+    }
+    
+    // node hierarchy
+    
+    // node field numbers, resolved once per struct array instead of once per node
+    struct node_fields {
+        int name;
+        int mesh_indices;
+        int transformation;
+        int children;
+        
+        // positions in node_field_names, for arrays created with them
+        node_fields() : name(0), mesh_indices(1), transformation(2), children(3) {}
+        
+        node_fields(const mxArray* matlab_nodes) :
+            name(field_number(matlab_nodes, "name")),
+            mesh_indices(field_number(matlab_nodes, "meshIndices")),
+            transformation(field_number(matlab_nodes, "transformation")),
+            children(field_number(matlab_nodes, "children")) {}
+    };
+    
+    static unsigned to_assimp_node(const mxArray* matlab_nodes, unsigned index, const node_fields& fields, aiNode** assimp_node, aiNode* assimp_parent) {
         *assimp_node = new aiNode();
         if (!*assimp_node) {
             return 0;
         }
         
         (*assimp_node)->mParent = assimp_parent;
-        get_string(matlab_node, index, "name", &(*assimp_node)->mName, "node");
-        get_4x4_in_place(matlab_node, index, "transformation", &(*assimp_node)->mTransformation);
-        (*assimp_node)->mMeshes = get_indices(matlab_node, index, "meshIndices", &(*assimp_node)->mNumMeshes);
+        get_string(matlab_nodes, index, fields.name, &(*assimp_node)->mName, "node");
+        get_4x4_in_place(matlab_nodes, index, fields.transformation, &(*assimp_node)->mTransformation);
+        (*assimp_node)->mMeshes = get_indices(matlab_nodes, index, fields.mesh_indices, &(*assimp_node)->mNumMeshes);
         
-        mxArray* matlab_children = mxGetField(matlab_node, index, "children");
-        if (!matlab_children) {
+        mxArray* matlab_children = get_field(matlab_nodes, index, fields.children);
+        if (!matlab_children || !mxIsStruct(matlab_children)) {
             return 0;
         }
         
@@ -521,27 +1239,32 @@ namespace mexximp {
         }
         (*assimp_node)->mChildren = child_array;
         
+        const node_fields child_fields(matlab_children);
         unsigned num_descendants = num_children;
-        for (int i = 0; i<num_children; i++) {
-            num_descendants += to_assimp_nodes(matlab_children, i, &child_array[i], *assimp_node);
+        for (unsigned i = 0; i < num_children; i++) {
+            num_descendants += to_assimp_node(matlab_children, i, child_fields, &child_array[i], *assimp_node);
         }
         
         return num_descendants;
     }
     
-    unsigned to_matlab_nodes(aiNode* assimp_node, mxArray** matlab_node, unsigned index) {
-        if (!matlab_node) {
+    unsigned to_assimp_nodes(const mxArray* matlab_node, unsigned index, aiNode** assimp_node, aiNode* assimp_parent) {
+        if (!matlab_node || !assimp_node || !mxIsStruct(matlab_node)) {
             return 0;
         }
         
-        if (!assimp_node) {
-            *matlab_node = emptyDouble();
-            return 0;
+        // flat hierarchy only comes at the root
+        if (!assimp_parent && 0 <= field_number(matlab_node, "parents")) {
+            return to_assimp_flat_nodes(matlab_node, assimp_node);
         }
         
-        set_string(*matlab_node, index, "name", &assimp_node->mName);
-        set_indices(*matlab_node, index, "meshIndices", assimp_node->mMeshes, assimp_node->mNumMeshes);
-        set_4x4(*matlab_node, index, "transformation", &assimp_node->mTransformation, 1);
+        return to_assimp_node(matlab_node, index, node_fields(matlab_node), assimp_node, assimp_parent);
+    }
+    
+    static unsigned to_matlab_node(aiNode* assimp_node, mxArray* matlab_nodes, unsigned index, const node_fields& fields) {
+        set_string(matlab_nodes, index, fields.name, &assimp_node->mName);
+        set_indices(matlab_nodes, index, fields.mesh_indices, assimp_node->mMeshes, assimp_node->mNumMeshes);
+        set_4x4(matlab_nodes, index, fields.transformation, &assimp_node->mTransformation, 1);
         
         unsigned num_children = assimp_node->mNumChildren;
         if (!num_children) {
@@ -557,16 +1280,214 @@ namespace mexximp {
             return 0;
         }
         
-        mxSetField(*matlab_node, index, "children", children);
+        set_field(matlab_nodes, index, fields.children, children);
         
+        // children are created with node_field_names, so their fields are at fixed positions
+        const node_fields child_fields;
         unsigned num_descendants = num_children;
-        for (int i = 0; i<num_children; i++) {
-            num_descendants += to_matlab_nodes(assimp_node->mChildren[i], &children, i);
+        for (unsigned i = 0; i < num_children; i++) {
+            if (assimp_node->mChildren[i]) {
+                num_descendants += to_matlab_node(assimp_node->mChildren[i], children, i, child_fields);
+            }
         }
         
         return num_descendants;
     }
     
+    unsigned to_matlab_nodes(aiNode* assimp_node, mxArray** matlab_node, unsigned index) {
+        if (!matlab_node) {
+            return 0;
+        }
+        
+        if (!assimp_node) {
+            *matlab_node = emptyDouble();
+            return 0;
+        }
+        
+        return to_matlab_node(assimp_node, *matlab_node, index, node_fields(*matlab_node));
+    }
+    
+    // flat node hierarchy, depth first so parents come before children
+    // parents(i) is the 0-based index of the parent of node i, or -1 for the root
+    // transformations(:,:,i) is the transformation of node i
+    // node i has meshIndices from meshOffsets(i) to meshOffsets(i+1)
+    
+    unsigned to_assimp_flat_nodes(const mxArray* matlab_nodes, aiNode** assimp_root) {
+        if (!matlab_nodes || !assimp_root || !mxIsStruct(matlab_nodes)) {
+            return 0;
+        }
+        
+        const mxArray* matlab_parents = mxGetField(matlab_nodes, 0, "parents");
+        if (!matlab_parents || !mxIsInt32(matlab_parents) || mxIsEmpty(matlab_parents)) {
+            return 0;
+        }
+        
+        // each parent must come before its children
+        const int32_T* parents = (const int32_T*)mxGetData(matlab_parents);
+        unsigned num_nodes = mxGetNumberOfElements(matlab_parents);
+        if (-1 != parents[0]) {
+            return 0;
+        }
+        for (unsigned i = 1; i < num_nodes; i++) {
+            if (0 > parents[i] || i <= (unsigned)parents[i]) {
+                return 0;
+            }
+        }
+        
+        const mxArray* matlab_names = mxGetField(matlab_nodes, 0, "names");
+        if (matlab_names && (!mxIsCell(matlab_names) || num_nodes != mxGetNumberOfElements(matlab_names))) {
+            matlab_names = 0;
+        }
+        
+        const mxArray* matlab_transformations = mxGetField(matlab_nodes, 0, "transformations");
+        const double* transformations = 0;
+        if (matlab_transformations && mxIsDouble(matlab_transformations)
+                && 16 * num_nodes == mxGetNumberOfElements(matlab_transformations)) {
+            transformations = mxGetPr(matlab_transformations);
+        }
+        
+        // mesh indices only if offsets climb and stay within the given indices
+        const mxArray* matlab_offsets = mxGetField(matlab_nodes, 0, "meshOffsets");
+        const mxArray* matlab_indices = mxGetField(matlab_nodes, 0, "meshIndices");
+        const uint32_T* mesh_offsets = 0;
+        const uint32_T* mesh_indices = 0;
+        if (matlab_offsets && mxIsUint32(matlab_offsets) && num_nodes + 1 == mxGetNumberOfElements(matlab_offsets)
+                && matlab_indices && mxIsUint32(matlab_indices)) {
+            mesh_offsets = (const uint32_T*)mxGetData(matlab_offsets);
+            mesh_indices = (const uint32_T*)mxGetData(matlab_indices);
+            for (unsigned i = 0; i < num_nodes; i++) {
+                if (mesh_offsets[i] > mesh_offsets[i + 1]) {
+                    mesh_offsets = 0;
+                    break;
+                }
+            }
+            if (mesh_offsets && mesh_offsets[num_nodes] > mxGetNumberOfElements(matlab_indices)) {
+                mesh_offsets = 0;
+            }
+        }
+        
+        std::vector<aiNode*> nodes(num_nodes);
+        std::vector<unsigned> num_children(num_nodes, 0);
+        for (unsigned i = 0; i < num_nodes; i++) {
+            aiNode* node = new aiNode();
+            nodes[i] = node;
+            
+            if (!matlab_names || !to_assimp_string(mxGetCell(matlab_names, i), &node->mName)) {
+                node->mName.Set("node");
+            }
+            
+            if (transformations) {
+                narrow_doubles(&transformations[16 * i], (float*)&node->mTransformation, 16);
+            }
+            
+            if (mesh_offsets && mesh_offsets[i] < mesh_offsets[i + 1]) {
+                node->mNumMeshes = mesh_offsets[i + 1] - mesh_offsets[i];
+                node->mMeshes = new unsigned[node->mNumMeshes];
+                memcpy(node->mMeshes, &mesh_indices[mesh_offsets[i]], node->mNumMeshes * sizeof(uint32_T));
+            }
+            
+            if (0 < i) {
+                node->mParent = nodes[parents[i]];
+                num_children[parents[i]]++;
+            }
+        }
+        
+        for (unsigned i = 0; i < num_nodes; i++) {
+            if (num_children[i]) {
+                nodes[i]->mChildren = new aiNode*[num_children[i]];
+            }
+        }
+        
+        for (unsigned i = 1; i < num_nodes; i++) {
+            aiNode* parent = nodes[parents[i]];
+            parent->mChildren[parent->mNumChildren++] = nodes[i];
+        }
+        
+        *assimp_root = nodes[0];
+        return num_nodes;
+    }
+    
+    unsigned to_matlab_flat_nodes(aiNode* assimp_root, mxArray** matlab_nodes) {
+        if (!matlab_nodes) {
+            return 0;
+        }
+        
+        if (!assimp_root) {
+            *matlab_nodes = emptyDouble();
+            return 0;
+        }
+        
+        // walk depth first without recursion, to handle deep hierarchies
+        std::vector<const aiNode*> nodes;
+        std::vector<int32_T> parents;
+        std::vector<std::pair<const aiNode*, int32_T> > stack(1, std::make_pair((const aiNode*)assimp_root, -1));
+        unsigned num_mesh_indices = 0;
+        while (!stack.empty()) {
+            const aiNode* node = stack.back().first;
+            parents.push_back(stack.back().second);
+            stack.pop_back();
+            
+            int32_T node_index = nodes.size();
+            nodes.push_back(node);
+            num_mesh_indices += node->mNumMeshes;
+            
+            // push children in reverse so they come off in order
+            for (unsigned c = node->mNumChildren; c > 0; c--) {
+                stack.push_back(std::make_pair((const aiNode*)node->mChildren[c - 1], node_index));
+            }
+        }
+        
+        unsigned num_nodes = nodes.size();
+        mxArray* names = mxCreateCellMatrix(1, num_nodes);
+        mxArray* matlab_parents = mxCreateNumericMatrix(1, num_nodes, mxINT32_CLASS, mxREAL);
+        mwSize dims[3] = {4, 4, num_nodes};
+        mxArray* transformations = mxCreateNumericArray(3, &dims[0], mxDOUBLE_CLASS, mxREAL);
+        mxArray* mesh_offsets = mxCreateNumericMatrix(1, num_nodes + 1, mxUINT32_CLASS, mxREAL);
+        mxArray* mesh_indices = mxCreateNumericMatrix(1, num_mesh_indices, mxUINT32_CLASS, mxREAL);
+        
+        *matlab_nodes = mxCreateStructMatrix(
+                1,
+                1,
+                COUNT(flat_node_field_names),
+                &flat_node_field_names[0]);
+        mxSetField(*matlab_nodes, 0, "names", names);
+        mxSetField(*matlab_nodes, 0, "parents", matlab_parents);
+        mxSetField(*matlab_nodes, 0, "transformations", transformations);
+        mxSetField(*matlab_nodes, 0, "meshOffsets", mesh_offsets);
+        mxSetField(*matlab_nodes, 0, "meshIndices", mesh_indices);
+        
+        int32_T* parents_data = (int32_T*)mxGetData(matlab_parents);
+        double* transformations_data = mxGetPr(transformations);
+        uint32_T* offsets_data = (uint32_T*)mxGetData(mesh_offsets);
+        uint32_T* indices_data = (uint32_T*)mxGetData(mesh_indices);
+        if (!parents_data || !transformations_data || !offsets_data) {
+            return 0;
+        }
+        
+        unsigned offset = 0;
+        for (unsigned i = 0; i < num_nodes; i++) {
+            const aiNode* node = nodes[i];
+            
+            mxArray* name;
+            to_matlab_string(&node->mName, &name);
+            mxSetCell(names, i, name);
+            
+            parents_data[i] = parents[i];
+            
+            // same memory order, Assimp rows become Matlab columns
+            widen_floats((const float*)&node->mTransformation, &transformations_data[16 * i], 16);
+            
+            offsets_data[i] = offset;
+            if (node->mNumMeshes) {
+                memcpy(&indices_data[offset], node->mMeshes, node->mNumMeshes * sizeof(uint32_T));
+                offset += node->mNumMeshes;
+            }
+        }
+        offsets_data[num_nodes] = offset;
+        
+        return num_nodes;
+    }
+    
     // embedded textures
     
     unsigned to_assimp_textures(const mxArray* matlab_textures, aiTexture*** assimp_textures) {
@@ -580,10 +1501,13 @@ namespace mexximp {
             return 0;
         }
         
+        const int image_field = field_number(matlab_textures, "image");
+        const int format_field = field_number(matlab_textures, "format");
+        
         for (unsigned i = 0; i < num_textures; i++) {
             (*assimp_textures)[i] = new aiTexture();
             
-            mxArray* matlab_texels = mxGetField(matlab_textures, i, "image");
+            mxArray* matlab_texels = get_field(matlab_textures, i, image_field);
             if (!mxIsUint8(matlab_texels)) {
                 continue;
             }
@@ -603,15 +1527,15 @@ namespace mexximp {
             
             if (0 == (*assimp_textures)[i]->mHeight) {
                 // raw bytes of compressed texture
-                (*assimp_textures)[i]->pcData = (aiTexel*) get_bytes(matlab_textures, i, "image", &(*assimp_textures)[i]->mWidth);
+                (*assimp_textures)[i]->pcData = (aiTexel*) get_bytes(matlab_textures, i, image_field, &(*assimp_textures)[i]->mWidth);
                 
                 // take up to 3 chars of format string, plus null terminator
-                mxArray* matlab_format = mxGetField(matlab_textures, i, "format");
+                mxArray* matlab_format = get_field(matlab_textures, i, format_field);
                 mxGetString(matlab_format, (*assimp_textures)[i]->achFormatHint, 4);
                 
             } else {
                 // rgba8888 texels of uncompressed texture
-                (*assimp_textures)[i]->pcData = get_texel(matlab_textures, i, "image", 0);
+                (*assimp_textures)[i]->pcData = get_texel(matlab_textures, i, image_field, 0);
                 // let format string remain zeroed
             }
         }
@@ -635,16 +1559,19 @@ namespace mexximp {
                 COUNT(texture_field_names),
                 &texture_field_names[0]);
         
+        const int image_field = field_number(*matlab_textures, "image");
+        const int format_field = field_number(*matlab_textures, "format");
+        
         for (unsigned i = 0; i < num_textures; i++) {
             if (0 == assimp_textures[i]->mHeight) {
                 // raw bytes of compressed texture
-                set_bytes(*matlab_textures, i, "image", (char*)assimp_textures[i]->pcData, assimp_textures[i]->mWidth);
-                set_c_string(*matlab_textures, i, "format", assimp_textures[i]->achFormatHint);
+                set_bytes(*matlab_textures, i, image_field, (char*)assimp_textures[i]->pcData, assimp_textures[i]->mWidth);
+                set_c_string(*matlab_textures, i, format_field, assimp_textures[i]->achFormatHint);
                 
             } else {
                 // rgba8888 texels of uncompressed texture
-                set_texel(*matlab_textures, i, "image", assimp_textures[i]->pcData, assimp_textures[i]->mWidth, assimp_textures[i]->mHeight);
-                set_c_string(*matlab_textures, i, "format", "");
+                set_texel(*matlab_textures, i, image_field, assimp_textures[i]->pcData, assimp_textures[i]->mWidth, assimp_textures[i]->mHeight);
+                set_c_string(*matlab_textures, i, format_field, "");
             }
         }
         
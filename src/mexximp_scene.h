@@ -6,21 +6,145 @@
  *  these allocations when the top-level scene is destroyed.  So just make
  *  sure the top-level scene gets destroyed!
  *
+ *  When given an arena, faces and material properties come from the arena
+ *  instead, and borrowed_buffers_guard hides them from Assimp's deletes.
+ *
  *  2015 benjamin.heasly@gmail.com
  */
 
 #ifndef MEXXIMP_SCENE_H_
 #define MEXXIMP_SCENE_H_
 
+#include <string>
+#include <vector>
 #include <assimp/scene.h>
 #include "mexximp_util.h"
+#include "mexximp_timing.h"
 
 namespace mexximp {
     
+    // Assimp config property, like AI_CONFIG_PP_SLM_VERTEX_LIMIT, which is named "PP_SLM_VERTEX_LIMIT"
+    
+    enum config_property_type {
+        config_integer,
+        config_float,
+        config_string,
+        config_matrix,
+    };
+    
+    struct config_property {
+        std::string name;
+        config_property_type type;
+        int integer_value;
+        float float_value;
+        std::string string_value;
+        aiMatrix4x4 matrix_value;
+        
+        config_property() : type(config_integer), integer_value(0), float_value(0) {}
+    };
+    
+    // set properties on an Assimp::Importer or Assimp::ExportProperties, which have the same setters
+    template <typename T>
+    void apply_config(T* target, const std::vector<config_property>& config) {
+        for (size_t i = 0; i < config.size(); i++) {
+            const config_property& property = config[i];
+            switch (property.type) {
+                case config_integer:
+                    target->SetPropertyInteger(property.name.c_str(), property.integer_value);
+                    break;
+                case config_float:
+                    target->SetPropertyFloat(property.name.c_str(), property.float_value);
+                    break;
+                case config_string:
+                    target->SetPropertyString(property.name.c_str(), property.string_value);
+                    break;
+                case config_matrix:
+                    target->SetPropertyMatrix(property.name.c_str(), property.matrix_value);
+                    break;
+            }
+        }
+    }
+    
+    // choices about how to lay out imported data in Matlab
+    
+    struct import_options {
+        // faces as one uint32 matrix or offsets + indices, not a struct per face
+        bool packed_faces;
+        
+        // mesh vertices, normals, colors, etc. as single instead of double
+        bool single_precision;
+        
+        // threads for filling mesh data, 0 means one per CPU
+        unsigned num_threads;
+        
+        // reuse scenes already imported from the same, unchanged file
+        bool use_cache;
+        
+        // which mesh fields to import, bit i for mesh_field_names[i]
+        unsigned mesh_fields;
+        
+        // node hierarchy as flat arrays, not a struct with nested children
+        bool flat_nodes;
+        
+        // extra mesh field with the box around the mesh vertices
+        bool mesh_bounds;
+        
+        // read scene files through mmap instead of stdio, where available
+        bool memory_map;
+        
+        // Assimp config properties for the importer and postprocess steps
+        std::vector<config_property> config;
+        
+        import_options() : packed_faces(false), single_precision(false), num_threads(1), use_cache(false), mesh_fields(~0u), flat_nodes(false), mesh_bounds(false), memory_map(false) {}
+    };
+    
+    // choices about how to build Assimp data for export
+    
+    struct export_options {
+        // threads for building mesh data, 0 means one per CPU
+        unsigned num_threads;
+        
+        // point Assimp mesh arrays at single-precision Matlab data instead of copying it
+        //  only safe with borrowed_buffers_guard, so off here and on in matlab_export_options()
+        bool borrow_singles;
+        
+        // take faces and material properties from one arena, freed all at once after export
+        //  see borrowed_buffers_guard
+        bool use_arena;
+        
+        // return exported files as uint8 arrays, without writing to disk
+        bool to_blob;
+        
+        // Assimp config properties for the exporter and postprocess steps
+        std::vector<config_property> config;
+        
+        export_options() : num_threads(1), borrow_singles(false), use_arena(true), to_blob(false) {}
+    };
+    
     // aiScene to and from Matlab structs
     
-    unsigned to_assimp_scene(const mxArray* matlab_scene, aiScene* assimp_scene);
-    unsigned to_matlab_scene(const aiScene* assimp_scene, mxArray** matlab_scene);
+    // with a timing report, add a phase for each part of the scene
+    unsigned to_assimp_scene(const mxArray* matlab_scene, aiScene* assimp_scene, const export_options& options = export_options(), arena* scene_arena = 0, timing_report* timing = 0);
+    unsigned to_matlab_scene(const aiScene* assimp_scene, mxArray** matlab_scene, const import_options& options = import_options(), timing_report* timing = 0);
+    
+    // forget mesh arrays that point at Matlab data, so the aiScene destructor won't delete them
+    void detach_borrowed_buffers(const mxArray* matlab_scene, aiScene* assimp_scene);
+    
+    // declare right after the aiScene and its arena, so it detaches borrowed and arena arrays before the aiScene is destroyed
+    struct borrowed_buffers_guard {
+        const mxArray* matlab_scene;
+        aiScene* assimp_scene;
+        arena* scene_arena;
+        
+        borrowed_buffers_guard(const mxArray* matlab, aiScene* assimp, arena* assimp_arena = 0) : matlab_scene(matlab), assimp_scene(assimp), scene_arena(assimp_arena) {}
+        ~borrowed_buffers_guard() {
+            detach_borrowed_buffers(matlab_scene, assimp_scene);
+            if (scene_arena) {
+                detach_arena_allocations(assimp_scene);
+                scene_arena->release();
+            }
+        }
+    };
     
     unsigned to_assimp_cameras(const mxArray* matlab_cameras, aiCamera*** assimp_cameras);
     unsigned to_matlab_cameras(aiCamera** assimp_cameras, mxArray** matlab_cameras, unsigned num_cameras);
@@ -28,20 +152,26 @@ namespace mexximp {
     unsigned to_assimp_lights(const mxArray* matlab_lights, aiLight*** assimp_lights);
     unsigned to_matlab_lights(aiLight** assimp_lights, mxArray** matlab_lights, unsigned num_lights);
     
-    unsigned to_assimp_materials(const mxArray* matlab_materials, aiMaterial*** assimp_materials);
+    unsigned to_assimp_materials(const mxArray* matlab_materials, aiMaterial*** assimp_materials, arena* scene_arena = 0);
     unsigned to_matlab_materials(aiMaterial** assimp_materials, mxArray** matlab_materials, unsigned num_materials);
     
-    unsigned to_assimp_material_properties(const mxArray* matlab_properties, aiMaterialProperty*** assimp_properties);
+    unsigned to_assimp_material_properties(const mxArray* matlab_properties, aiMaterialProperty*** assimp_properties, arena* scene_arena = 0);
     unsigned to_matlab_material_properties(aiMaterialProperty** assimp_properties, mxArray** matlab_properties, unsigned num_properties);
     
-    unsigned to_assimp_meshes(const mxArray* matlab_meshes, aiMesh*** assimp_meshes);
-    unsigned to_matlab_meshes(aiMesh** assimp_meshes, mxArray** matlab_meshes, unsigned num_meshes);
+    unsigned to_assimp_meshes(const mxArray* matlab_meshes, aiMesh*** assimp_meshes, const export_options& options = export_options(), arena* scene_arena = 0);
+    unsigned to_matlab_meshes(aiMesh** assimp_meshes, mxArray** matlab_meshes, unsigned num_meshes, const import_options& options = import_options(), timing_report* timing = 0);
     
-    unsigned to_assimp_faces(const mxArray* matlab_faces, aiFace** assimp_faces);
+    unsigned to_assimp_faces(const mxArray* matlab_faces, aiFace** assimp_faces, arena* scene_arena = 0);
     unsigned to_matlab_faces(aiFace* assimp_faces, mxArray** matlab_faces, unsigned num_faces);
     
+    unsigned to_assimp_packed_faces(const mxArray* matlab_faces, aiFace** assimp_faces, arena* scene_arena = 0);
+    unsigned to_matlab_packed_faces(aiFace* assimp_faces, mxArray** matlab_faces, unsigned num_faces);
+    
     unsigned to_assimp_nodes(const mxArray* matlab_node, unsigned index, aiNode** assimp_node, aiNode* assimp_parent);
     unsigned to_matlab_nodes(aiNode* assimp_node, mxArray** matlab_node, unsigned index);
+    
+    unsigned to_assimp_flat_nodes(const mxArray* matlab_nodes, aiNode** assimp_root);
+    unsigned to_matlab_flat_nodes(aiNode* assimp_root, mxArray** matlab_nodes);
 
     unsigned to_assimp_textures(const mxArray* matlab_textures, aiTexture*** assimp_textures);
     unsigned to_matlab_textures(aiTexture** assimp_textures, mxArray** matlab_textures, unsigned num_textures);
@@ -2,10 +2,11 @@
 
 #include <mex.h>
 
+#include "mexximp_constants.h"
 #include "mexximp_scene.h"
 
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
-    if (2 != nrhs || !mxIsChar(prhs[0])) {
+    if (nrhs < 2 || !mxIsChar(prhs[0])) {
         plhs[0] = mexximp::emptyDouble();
         return;
     }
@@ -52,8 +53,21 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
         delete [] assimp_4x4;
         
     } else if(0 == strcmp("scene", whichTest)) {
+        mexximp::import_options options;
+        if (2 < nrhs && mxIsStruct(prhs[2])) {
+            options = mexximp::import_option_values(prhs[2]);
+        }
+        
+        mexximp::export_options assimp_options = mexximp::matlab_export_options();
+        if (3 < nrhs && mxIsStruct(prhs[3])) {
+            assimp_options = mexximp::export_option_values(prhs[3]);
+        }
+        
         aiScene assimp_scene;
-        mexximp::to_assimp_scene(prhs[1], &assimp_scene);
-        mexximp::to_matlab_scene(&assimp_scene, &plhs[0]);
+        mexximp::arena scene_arena;
+        mexximp::arena* arena = assimp_options.use_arena ? &scene_arena : 0;
+        mexximp::borrowed_buffers_guard guard(prhs[1], &assimp_scene, arena);
+        mexximp::to_assimp_scene(prhs[1], &assimp_scene, assimp_options, arena);
+        mexximp::to_matlab_scene(&assimp_scene, &plhs[0], options);
     }
 }
@@ -0,0 +1,70 @@
+// Simple worker threads for mexximp bulk conversions.
+
+#include "mexximp_threads.h"
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace mexximp {
+    
+    unsigned default_num_threads() {
+        unsigned num_threads = std::thread::hardware_concurrency();
+        return num_threads ? num_threads : 1;
+    }
+    
+    void parallel_for(size_t count, unsigned num_threads, const std::function<void(size_t)>& body) {
+        if (0 == num_threads) {
+            num_threads = default_num_threads();
+        }
+        if (num_threads > count) {
+            num_threads = count;
+        }
+        
+        if (num_threads <= 1) {
+            for (size_t i = 0; i < count; i++) {
+                body(i);
+            }
+            return;
+        }
+        
+        // each thread claims the next unclaimed index until none are left
+        // an exception stops all threads and is rethrown here, on the calling thread
+        std::atomic<size_t> next(0);
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        auto work = [&]() {
+            for (size_t i = next++; i < count; i = next++) {
+                try {
+                    body(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                    next = count;
+                }
+            }
+        };
+        
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < num_threads; t++) {
+            workers.push_back(std::thread(work));
+        }
+        work();
+        for (unsigned t = 0; t < workers.size(); t++) {
+            workers[t].join();
+        }
+        
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    
+    void run_jobs(const std::vector<std::function<void()> >& jobs, unsigned num_threads) {
+        parallel_for(jobs.size(), num_threads, [&](size_t i) {
+            jobs[i]();
+        });
+    }
+}
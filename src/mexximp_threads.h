@@ -0,0 +1,28 @@
+/** Simple worker threads for mexximp bulk conversions.
+ *
+ *  Matlab's mx API is not thread safe.  So callers should allocate any
+ *  mxArrays on the Matlab thread first, then use these functions only for
+ *  work that reads and writes plain memory, like filling mxArray data.
+ */
+
+#ifndef MEXXIMP_THREADS_H_
+#define MEXXIMP_THREADS_H_
+
+#include <stddef.h>
+#include <functional>
+#include <vector>
+
+namespace mexximp {
+    
+    // number of threads to use when the caller asks for 0, meaning "all"
+    unsigned default_num_threads();
+    
+    // call body(i) for i in [0, count) using up to num_threads threads, including the calling thread
+    // the first exception thrown by body is rethrown on the calling thread
+    void parallel_for(size_t count, unsigned num_threads, const std::function<void(size_t)>& body);
+    
+    // run each job once using up to num_threads threads, including the calling thread
+    void run_jobs(const std::vector<std::function<void()> >& jobs, unsigned num_threads);
+}
+
+#endif  // MEXXIMP_THREADS_H_
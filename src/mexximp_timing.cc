@@ -0,0 +1,70 @@
+// Per-phase timing for import and export.
+
+#include "mexximp_timing.h"
+#include "mexximp_constants.h"
+
+namespace mexximp {
+    
+    void phase_timer::start() {
+        wall_start = std::chrono::steady_clock::now();
+        cpu_start = std::clock();
+    }
+    
+    void phase_timer::stop() {
+        std::chrono::duration<double> wall = std::chrono::steady_clock::now() - wall_start;
+        wall_seconds += wall.count();
+        cpu_seconds += (double)(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+    }
+    
+    void timing_report::add(const std::string& name, const phase_timer& timer, double count, double bytes) {
+        phase_timing phase;
+        phase.name = name;
+        phase.wall_seconds = timer.wall_seconds;
+        phase.cpu_seconds = timer.cpu_seconds;
+        phase.count = count;
+        phase.bytes = bytes;
+        phases.push_back(phase);
+    }
+    
+    void phase_scope::finish(const std::string& name, double count, const mxArray* matlab_data) {
+        if (!report) {
+            return;
+        }
+        timer.stop();
+        report->add(name, timer, count, array_bytes(matlab_data));
+    }
+    
+    static const char* timing_field_names[] = {
+        "name",
+        "wallSeconds",
+        "cpuSeconds",
+        "count",
+        "bytes",
+        "countPerSecond",
+        "bytesPerSecond",
+    };
+    
+    mxArray* timing_report_struct(const timing_report& report) {
+        unsigned num_phases = report.phases.size();
+        mxArray* matlab_report = mxCreateStructMatrix(1, num_phases, COUNT(timing_field_names), &timing_field_names[0]);
+        if (!matlab_report) {
+            return 0;
+        }
+        
+        for (unsigned i = 0; i < num_phases; i++) {
+            const phase_timing& phase = report.phases[i];
+            mxSetField(matlab_report, i, "name", mxCreateString(phase.name.c_str()));
+            mxSetField(matlab_report, i, "wallSeconds", mxCreateDoubleScalar(phase.wall_seconds));
+            mxSetField(matlab_report, i, "cpuSeconds", mxCreateDoubleScalar(phase.cpu_seconds));
+            mxSetField(matlab_report, i, "count", mxCreateDoubleScalar(phase.count));
+            mxSetField(matlab_report, i, "bytes", mxCreateDoubleScalar(phase.bytes));
+            
+            // phases too quick for the clock get rate 0 rather than inf
+            double seconds = phase.wall_seconds;
+            mxSetField(matlab_report, i, "countPerSecond", mxCreateDoubleScalar(0 < seconds ? phase.count / seconds : 0));
+            mxSetField(matlab_report, i, "bytesPerSecond", mxCreateDoubleScalar(0 < seconds ? phase.bytes / seconds : 0));
+        }
+        
+        return matlab_report;
+    }
+}
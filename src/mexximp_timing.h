@@ -0,0 +1,69 @@
+/** Per-phase timing for import and export.
+ *
+ *  Each phase records wall-clock seconds, CPU seconds, a count of elements
+ *  it produced, and the bytes it produced.  CPU time comes from
+ *  std::clock, so it covers the whole process, including worker threads,
+ *  and it can exceed wall-clock time when phases run in parallel.
+ *
+ *  Timing is optional.  Functions that take a timing_report* do no extra
+ *  work when it's 0.
+ */
+
+#ifndef MEXXIMP_TIMING_H_
+#define MEXXIMP_TIMING_H_
+
+#include <stddef.h>
+#include <chrono>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <matrix.h>
+
+namespace mexximp {
+    
+    struct phase_timing {
+        std::string name;
+        double wall_seconds;
+        double cpu_seconds;
+        double count;
+        double bytes;
+    };
+    
+    // accumulates time between start and stop, so one timer can cover several separate intervals
+    struct phase_timer {
+        double wall_seconds;
+        double cpu_seconds;
+        std::chrono::steady_clock::time_point wall_start;
+        std::clock_t cpu_start;
+        
+        phase_timer() : wall_seconds(0), cpu_seconds(0), cpu_start(0) {}
+        void start();
+        void stop();
+    };
+    
+    struct timing_report {
+        std::vector<phase_timing> phases;
+        
+        void add(const std::string& name, const phase_timer& timer, double count, double bytes);
+    };
+    
+    // times one phase from construction until finish, only when report is not 0
+    struct phase_scope {
+        timing_report* report;
+        phase_timer timer;
+        
+        phase_scope(timing_report* timing) : report(timing) {
+            if (report) {
+                timer.start();
+            }
+        }
+        
+        // bytes are counted from matlab_data, which was produced or consumed by the phase
+        void finish(const std::string& name, double count, const mxArray* matlab_data);
+    };
+    
+    // 1xN struct with name, wallSeconds, cpuSeconds, count, bytes, countPerSecond, and bytesPerSecond
+    mxArray* timing_report_struct(const timing_report& report);
+}
+
+#endif  // MEXXIMP_TIMING_H_
@@ -6,16 +6,66 @@
 #include <mex.h>
 #include <matrix.h>
 #include <tmwtypes.h>
+#include "mexximp_kernels.h"
 #include "mexximp_util.h"
 
 namespace mexximp {
     
     // basic Assimp type conversions
     
+    // single precision
+    
+    // Assimp vectors and colors are packed floats, same as Matlab single columns
+    template <typename T>
+    static unsigned to_assimp_single(const mxArray* matlab_single, T** assimp_vectors, unsigned num_components) {
+        float* matlab_data = (float*)mxGetData(matlab_single);
+        if (!matlab_data) {
+            *assimp_vectors = 0;
+            return 0;
+        }
+        
+        unsigned num_vectors = mxGetNumberOfElements(matlab_single) / num_components;
+        *assimp_vectors = new T[num_vectors];
+        if (!*assimp_vectors) {
+            return 0;
+        }
+        
+        memcpy((void*)*assimp_vectors, matlab_data, num_vectors * sizeof(T));
+        
+        return num_vectors;
+    }
+    
+    template <typename T>
+    static unsigned to_matlab_single(const T* assimp_vectors, mxArray** matlab_single, unsigned num_vectors, unsigned num_components) {
+        if (!assimp_vectors || 0 == num_vectors) {
+            *matlab_single = mxCreateNumericMatrix(num_components, 0, mxSINGLE_CLASS, mxREAL);
+            return 0;
+        }
+        
+        *matlab_single = mxCreateNumericMatrix(num_components, num_vectors, mxSINGLE_CLASS, mxREAL);
+        
+        float* matlab_data = (float*)mxGetData(*matlab_single);
+        if (!matlab_data) {
+            return 0;
+        }
+        
+        memcpy(matlab_data, assimp_vectors, num_vectors * sizeof(T));
+        
+        return num_vectors;
+    }
+    
     // xyz
     
     unsigned to_assimp_xyz(const mxArray* matlab_xyz, aiVector3D** assimp_xyz) {
-        if (!matlab_xyz || !assimp_xyz || !mxIsDouble(matlab_xyz)) {
+        if (!matlab_xyz || !assimp_xyz) {
+            return 0;
+        }
+        
+        if (mxIsSingle(matlab_xyz)) {
+            return to_assimp_single(matlab_xyz, assimp_xyz, 3);
+        }
+        
+        if (!mxIsDouble(matlab_xyz)) {
             return 0;
         }
         
@@ -31,20 +81,20 @@ namespace mexximp {
             return 0;
         }
         
-        for (unsigned i = 0; i < num_vectors; i++) {
-            (*assimp_xyz)[i].x = matlab_data[3 * i];
-            (*assimp_xyz)[i].y = matlab_data[3 * i + 1];
-            (*assimp_xyz)[i].z = matlab_data[3 * i + 2];
-        }
+        narrow_doubles(matlab_data, (float*)*assimp_xyz, 3 * num_vectors);
         
         return num_vectors;
     }
     
-    unsigned to_matlab_xyz(const aiVector3D* assimp_xyz, mxArray** matlab_xyz, unsigned num_vectors) {
+    unsigned to_matlab_xyz(const aiVector3D* assimp_xyz, mxArray** matlab_xyz, unsigned num_vectors, bool single_precision) {
         if (!matlab_xyz) {
             return 0;
         }
         
+        if (single_precision) {
+            return to_matlab_single(assimp_xyz, matlab_xyz, num_vectors, 3);
+        }
+        
         if (!assimp_xyz || 0 == num_vectors) {
             *matlab_xyz = mxCreateDoubleMatrix(3, 0, mxREAL);
             return 0;
@@ -57,11 +107,7 @@ namespace mexximp {
             return 0;
         }
         
-        for (unsigned i = 0; i < num_vectors; i++) {
-            matlab_data[3 * i] = assimp_xyz[i].x;
-            matlab_data[3 * i + 1] = assimp_xyz[i].y;
-            matlab_data[3 * i + 2] = assimp_xyz[i].z;
-        }
+        widen_floats((const float*)assimp_xyz, matlab_data, 3 * num_vectors);
         
         return num_vectors;
     }
@@ -98,7 +144,15 @@ namespace mexximp {
     // rgb
     
     unsigned to_assimp_rgb(const mxArray* matlab_rgb, aiColor3D** assimp_rgb) {
-        if (!matlab_rgb || !assimp_rgb || !mxIsDouble(matlab_rgb)) {
+        if (!matlab_rgb || !assimp_rgb) {
+            return 0;
+        }
+        
+        if (mxIsSingle(matlab_rgb)) {
+            return to_assimp_single(matlab_rgb, assimp_rgb, 3);
+        }
+        
+        if (!mxIsDouble(matlab_rgb)) {
             return 0;
         }
         
@@ -114,20 +168,20 @@ namespace mexximp {
             return 0;
         }
         
-        for (unsigned i = 0; i < num_vectors; i++) {
-            (*assimp_rgb)[i].r = matlab_data[3 * i];
-            (*assimp_rgb)[i].g = matlab_data[3 * i + 1];
-            (*assimp_rgb)[i].b = matlab_data[3 * i + 2];
-        }
+        narrow_doubles(matlab_data, (float*)*assimp_rgb, 3 * num_vectors);
         
         return num_vectors;
     }
     
-    unsigned to_matlab_rgb(const aiColor3D* assimp_rgb, mxArray** matlab_rgb, unsigned num_vectors) {
+    unsigned to_matlab_rgb(const aiColor3D* assimp_rgb, mxArray** matlab_rgb, unsigned num_vectors, bool single_precision) {
         if (!matlab_rgb) {
             return 0;
         }
         
+        if (single_precision) {
+            return to_matlab_single(assimp_rgb, matlab_rgb, num_vectors, 3);
+        }
+        
         if (!assimp_rgb || 0 == num_vectors) {
             *matlab_rgb = mxCreateDoubleMatrix(3, 0, mxREAL);
             return 0;
@@ -140,11 +194,7 @@ namespace mexximp {
             return 0;
         }
         
-        for (unsigned i = 0; i < num_vectors; i++) {
-            matlab_data[3 * i] = assimp_rgb[i].r;
-            matlab_data[3 * i + 1] = assimp_rgb[i].g;
-            matlab_data[3 * i + 2] = assimp_rgb[i].b;
-        }
+        widen_floats((const float*)assimp_rgb, matlab_data, 3 * num_vectors);
         
         return num_vectors;
     }
@@ -152,7 +202,15 @@ namespace mexximp {
     // rgba (float values)
     
     unsigned to_assimp_rgba(const mxArray* matlab_rgba, aiColor4D** assimp_rgba) {
-        if (!matlab_rgba || !assimp_rgba || !mxIsDouble(matlab_rgba)) {
+        if (!matlab_rgba || !assimp_rgba) {
+            return 0;
+        }
+        
+        if (mxIsSingle(matlab_rgba)) {
+            return to_assimp_single(matlab_rgba, assimp_rgba, 4);
+        }
+        
+        if (!mxIsDouble(matlab_rgba)) {
             return 0;
         }
         
@@ -168,21 +226,20 @@ namespace mexximp {
             return 0;
         }
         
-        for (unsigned i = 0; i < num_vectors; i++) {
-            (*assimp_rgba)[i].r = matlab_data[4 * i];
-            (*assimp_rgba)[i].g = matlab_data[4 * i + 1];
-            (*assimp_rgba)[i].b = matlab_data[4 * i + 2];
-            (*assimp_rgba)[i].a = matlab_data[4 * i + 3];
-        }
+        narrow_doubles(matlab_data, (float*)*assimp_rgba, 4 * num_vectors);
         
         return num_vectors;
     }
     
-    unsigned to_matlab_rgba(const aiColor4D* assimp_rgba, mxArray** matlab_rgba, unsigned num_vectors) {
+    unsigned to_matlab_rgba(const aiColor4D* assimp_rgba, mxArray** matlab_rgba, unsigned num_vectors, bool single_precision) {
         if (!matlab_rgba) {
             return 0;
         }
         
+        if (single_precision) {
+            return to_matlab_single(assimp_rgba, matlab_rgba, num_vectors, 4);
+        }
+        
         if (!assimp_rgba || 0 == num_vectors) {
             *matlab_rgba = mxCreateDoubleMatrix(4, 0, mxREAL);
             return 0;
@@ -195,12 +252,7 @@ namespace mexximp {
             return 0;
         }
         
-        for (unsigned i = 0; i < num_vectors; i++) {
-            matlab_data[4 * i] = assimp_rgba[i].r;
-            matlab_data[4 * i + 1] = assimp_rgba[i].g;
-            matlab_data[4 * i + 2] = assimp_rgba[i].b;
-            matlab_data[4 * i + 3] = assimp_rgba[i].a;
-        }
+        widen_floats((const float*)assimp_rgba, matlab_data, 4 * num_vectors);
         
         return num_vectors;
     }
@@ -224,12 +276,7 @@ namespace mexximp {
             return 0;
         }
         
-        for (unsigned i = 0; i < num_vectors; i++) {
-            (*assimp_texel)[i].r = matlab_data[4 * i];
-            (*assimp_texel)[i].g = matlab_data[4 * i + 1];
-            (*assimp_texel)[i].b = matlab_data[4 * i + 2];
-            (*assimp_texel)[i].a = matlab_data[4 * i + 3];
-        }
+        swap_red_blue((const unsigned char*)matlab_data, (unsigned char*)*assimp_texel, num_vectors);
         
         return num_vectors;
     }
@@ -257,12 +304,7 @@ namespace mexximp {
         }
         
         unsigned num_vectors = width * height;
-        for (unsigned i = 0; i < num_vectors; i++) {
-            matlab_data[4 * i] = assimp_texel[i].r;
-            matlab_data[4 * i + 1] = assimp_texel[i].g;
-            matlab_data[4 * i + 2] = assimp_texel[i].b;
-            matlab_data[4 * i + 3] = assimp_texel[i].a;
-        }
+        swap_red_blue((const unsigned char*)assimp_texel, (unsigned char*)matlab_data, num_vectors);
         
         return num_vectors;
     }
@@ -286,27 +328,8 @@ namespace mexximp {
             return 0;
         }
         
-        for (unsigned i = 0; i < num_matrices; i++) {
-            (*assimp_4x4)[i].a1 = matlab_data[16 * i];
-            (*assimp_4x4)[i].a2 = matlab_data[16 * i + 1];
-            (*assimp_4x4)[i].a3 = matlab_data[16 * i + 2];
-            (*assimp_4x4)[i].a4 = matlab_data[16 * i + 3];
-            
-            (*assimp_4x4)[i].b1 = matlab_data[16 * i + 4];
-            (*assimp_4x4)[i].b2 = matlab_data[16 * i + 5];
-            (*assimp_4x4)[i].b3 = matlab_data[16 * i + 6];
-            (*assimp_4x4)[i].b4 = matlab_data[16 * i + 7];
-            
-            (*assimp_4x4)[i].c1 = matlab_data[16 * i + 8];
-            (*assimp_4x4)[i].c2 = matlab_data[16 * i + 9];
-            (*assimp_4x4)[i].c3 = matlab_data[16 * i + 10];
-            (*assimp_4x4)[i].c4 = matlab_data[16 * i + 11];
-            
-            (*assimp_4x4)[i].d1 = matlab_data[16 * i + 12];
-            (*assimp_4x4)[i].d2 = matlab_data[16 * i + 13];
-            (*assimp_4x4)[i].d3 = matlab_data[16 * i + 14];
-            (*assimp_4x4)[i].d4 = matlab_data[16 * i + 15];
-        }
+        // same memory order, Assimp rows become Matlab columns
+        narrow_doubles(matlab_data, (float*)*assimp_4x4, 16 * num_matrices);
         
         return num_matrices;
     }
@@ -333,60 +356,54 @@ namespace mexximp {
             return 0;
         }
         
-        for (unsigned i = 0; i < num_matrices; i++) {
-            matlab_data[16 * i] = assimp_4x4[i].a1;
-            matlab_data[16 * i + 1] = assimp_4x4[i].a2;
-            matlab_data[16 * i + 2] = assimp_4x4[i].a3;
-            matlab_data[16 * i + 3] = assimp_4x4[i].a4;
-            
-            matlab_data[16 * i + 4] = assimp_4x4[i].b1;
-            matlab_data[16 * i + 5] = assimp_4x4[i].b2;
-            matlab_data[16 * i + 6] = assimp_4x4[i].b3;
-            matlab_data[16 * i + 7] = assimp_4x4[i].b4;
-            
-            matlab_data[16 * i + 8] = assimp_4x4[i].c1;
-            matlab_data[16 * i + 9] = assimp_4x4[i].c2;
-            matlab_data[16 * i + 10] = assimp_4x4[i].c3;
-            matlab_data[16 * i + 11] = assimp_4x4[i].c4;
-            
-            matlab_data[16 * i + 12] = assimp_4x4[i].d1;
-            matlab_data[16 * i + 13] = assimp_4x4[i].d2;
-            matlab_data[16 * i + 14] = assimp_4x4[i].d3;
-            matlab_data[16 * i + 15] = assimp_4x4[i].d4;
-        }
+        // same memory order, Assimp rows become Matlab columns
+        widen_floats((const float*)assimp_4x4, matlab_data, 16 * num_matrices);
         
         return num_matrices;
     }
     
     // data to and from structs
     
-    float get_scalar(const mxArray* matlab_struct, const unsigned index, const char* field_name, const float default_value) {
+    // narrow the first few elements straight into a target, leave the target alone if there are too few
+    static void get_first_floats(const mxArray* field, float* target, unsigned num_elements, bool allow_single) {
+        if (!field || mxGetNumberOfElements(field) < num_elements) {
+            return;
+        }
+        
+        if (allow_single && mxIsSingle(field) && mxGetData(field)) {
+            memcpy(target, mxGetData(field), num_elements * sizeof(float));
+        } else if (mxIsDouble(field) && mxGetPr(field)) {
+            narrow_doubles(mxGetPr(field), target, num_elements);
+        }
+    }
+    
+    float get_scalar(const mxArray* matlab_struct, const unsigned index, const int field_number, const float default_value) {
         if (!matlab_struct || !mxIsStruct(matlab_struct)) {
             return default_value;
         }
-        const mxArray* field = mxGetField(matlab_struct, index, field_name);
+        const mxArray* field = get_field(matlab_struct, index, field_number);
         if (!field || !mxIsNumeric(field)) {
             return default_value;
         }
         return mxGetScalar(field);
     }
     
-    void set_scalar(mxArray* matlab_struct, const unsigned index, const char* field_name, const float value) {
+    void set_scalar(mxArray* matlab_struct, const unsigned index, const int field_number, const float value) {
         if (!matlab_struct || !mxIsStruct(matlab_struct)) {
             return;
         }
         mxArray* scalar = mxCreateDoubleScalar(value);
-        mxSetField(matlab_struct, index, field_name, scalar);
+        set_field(matlab_struct, index, field_number, scalar);
     }
     
     // floats to from struct
     
-    float* get_floats(const mxArray* matlab_struct, const unsigned index, const char* field_name, unsigned* num_elements_out) {
+    float* get_floats(const mxArray* matlab_struct, const unsigned index, const int field_number, unsigned* num_elements_out) {
         if (num_elements_out) {
             *num_elements_out = 0;
         }
         
-        const mxArray* field = mxGetField(matlab_struct, index, field_name);
+        const mxArray* field = get_field(matlab_struct, index, field_number);
         if (!field || !mxIsDouble(field)) {
             return 0;
         }
@@ -402,9 +419,7 @@ namespace mexximp {
         if (!target) {
             return 0;
         }
-        for (int i=0; i<num_elements; i++) {
-            target[i] = data[i];
-        }
+        narrow_doubles(data, target, num_elements);
         
         if (num_elements_out) {
             *num_elements_out = num_elements;
@@ -413,7 +428,7 @@ namespace mexximp {
         return target;
     }
     
-    void set_floats(mxArray* matlab_struct, const unsigned index, const char* field_name, const float* floats, unsigned num_elements) {
+    void set_floats(mxArray* matlab_struct, const unsigned index, const int field_number, const float* floats, unsigned num_elements) {
         mxArray* field;
         
         if (!num_elements) {
@@ -430,21 +445,19 @@ namespace mexximp {
             return;
         }
         
-        for (int i=0; i<num_elements; i++) {
-            data[i] = floats[i];
-        }
+        widen_floats(floats, data, num_elements);
         
-        mxSetField(matlab_struct, index, field_name, field);
+        set_field(matlab_struct, index, field_number, field);
     }
     
     // integers to from struct
     
-    int32_T* get_ints(const mxArray* matlab_struct, const unsigned index, const char* field_name, unsigned* num_elements_out) {
+    int32_T* get_ints(const mxArray* matlab_struct, const unsigned index, const int field_number, unsigned* num_elements_out) {
         if (num_elements_out) {
             *num_elements_out = 0;
         }
         
-        const mxArray* field = mxGetField(matlab_struct, index, field_name);
+        const mxArray* field = get_field(matlab_struct, index, field_number);
         if (!field || !mxIsInt32(field)) {
             return 0;
         }
@@ -469,7 +482,7 @@ namespace mexximp {
         return target;
     }
     
-    void set_ints(mxArray* matlab_struct, const unsigned index, const char* field_name, const int32_T* ints, unsigned num_elements) {
+    void set_ints(mxArray* matlab_struct, const unsigned index, const int field_number, const int32_T* ints, unsigned num_elements) {
         mxArray* field;
         
         if (!num_elements) {
@@ -489,17 +502,17 @@ namespace mexximp {
         unsigned num_bytes = num_elements * sizeof(int32_T);
         memcpy(data, ints, num_bytes);
         
-        mxSetField(matlab_struct, index, field_name, field);
+        set_field(matlab_struct, index, field_number, field);
     }
     
     // indices to from struct
     
-    uint32_T* get_indices(const mxArray* matlab_struct, const unsigned index, const char* field_name, unsigned* num_elements_out) {
+    uint32_T* get_indices(const mxArray* matlab_struct, const unsigned index, const int field_number, unsigned* num_elements_out) {
         if (num_elements_out) {
             *num_elements_out = 0;
         }
         
-        const mxArray* field = mxGetField(matlab_struct, index, field_name);
+        const mxArray* field = get_field(matlab_struct, index, field_number);
         if (!field || !mxIsUint32(field)) {
             return 0;
         }
@@ -511,7 +524,7 @@ namespace mexximp {
         
         unsigned num_elements = mxGetNumberOfElements(field);
         unsigned num_bytes = num_elements * sizeof(uint32_T);
-        uint32_T* target = new uint32_T[num_bytes];
+        uint32_T* target = new uint32_T[num_elements];
         if (!target) {
             return 0;
         }
@@ -524,7 +537,7 @@ namespace mexximp {
         return target;
     }
     
-    void set_indices(mxArray* matlab_struct, const unsigned index, const char* field_name, const uint32_T* indices, unsigned num_elements) {
+    void set_indices(mxArray* matlab_struct, const unsigned index, const int field_number, const uint32_T* indices, unsigned num_elements) {
         mxArray* field;
         
         if (!num_elements) {
@@ -544,17 +557,17 @@ namespace mexximp {
         unsigned num_bytes = num_elements * sizeof(uint32_T);
         memcpy(data, indices, num_bytes);
         
-        mxSetField(matlab_struct, index, field_name, field);
+        set_field(matlab_struct, index, field_number, field);
     }
     
     // bytes to from struct
     
-    char* get_bytes(const mxArray* matlab_struct, const unsigned index, const char* field_name, unsigned* num_elements_out) {
+    char* get_bytes(const mxArray* matlab_struct, const unsigned index, const int field_number, unsigned* num_elements_out) {
         if (num_elements_out) {
             *num_elements_out = 0;
         }
         
-        const mxArray* field = mxGetField(matlab_struct, index, field_name);
+        const mxArray* field = get_field(matlab_struct, index, field_number);
         if (!field) {
             return 0;
         }
@@ -578,7 +591,7 @@ namespace mexximp {
         return target;
     }
     
-    void set_bytes(mxArray* matlab_struct, const unsigned index, const char* field_name, const char* bytes, unsigned num_elements) {
+    void set_bytes(mxArray* matlab_struct, const unsigned index, const int field_number, const char* bytes, unsigned num_elements) {
         mxArray* field;
         
         if (!num_elements) {
@@ -597,234 +610,213 @@ namespace mexximp {
         
         memcpy(data, bytes, num_elements);
         
-        mxSetField(matlab_struct, index, field_name, field);
+        set_field(matlab_struct, index, field_number, field);
     }
     
     // string to from struct
     
-    unsigned get_string(const mxArray* matlab_struct, const unsigned index, const char* field_name, aiString* target, const char* default_value) {
-        unsigned length = to_assimp_string(mxGetField(matlab_struct, index, field_name), target);
+    unsigned get_string(const mxArray* matlab_struct, const unsigned index, const int field_number, aiString* target, const char* default_value) {
+        unsigned length = to_assimp_string(get_field(matlab_struct, index, field_number), target);
         if (!length) {
             target->Set(default_value);
         }
         return target->length;
     }
     
-    void set_string(mxArray* matlab_struct, const unsigned index, const char* field_name, const aiString* value) {
+    void set_string(mxArray* matlab_struct, const unsigned index, const int field_number, const aiString* value) {
         mxArray* string;
         to_matlab_string(value, &string);
         if (string) {
-            mxSetField(matlab_struct, index, field_name, string);
+            set_field(matlab_struct, index, field_number, string);
         }
     }
     
-    const char* get_c_string(const mxArray* matlab_struct, const unsigned index, const char* field_name, const char* default_value) {
-        mxArray* string = mxGetField(matlab_struct, index, field_name);
+    const char* get_c_string(const mxArray* matlab_struct, const unsigned index, const int field_number, const char* default_value) {
+        mxArray* string = get_field(matlab_struct, index, field_number);
         if (!string) {
             return default_value;
         }
         return mxArrayToString(string);
     }
     
-    void set_c_string(mxArray* matlab_struct, const unsigned index, const char* field_name, const char* value) {
+    void set_c_string(mxArray* matlab_struct, const unsigned index, const int field_number, const char* value) {
         mxArray* string = mxCreateString(value);
         if (string) {
-            mxSetField(matlab_struct, index, field_name, string);
+            set_field(matlab_struct, index, field_number, string);
         }
     }
     
     // xyz to from struct
     
-    aiVector3D* get_xyz(const mxArray* matlab_struct, const unsigned index, const char* field_name, unsigned* num_vectors_out) {
-        aiVector3D* target;
-        unsigned num_vectors = to_assimp_xyz(mxGetField(matlab_struct, index, field_name), &target);
+    aiVector3D* get_xyz(const mxArray* matlab_struct, const unsigned index, const int field_number, unsigned* num_vectors_out) {
+        aiVector3D* target = 0;
+        unsigned num_vectors = to_assimp_xyz(get_field(matlab_struct, index, field_number), &target);
         if (num_vectors_out) {
             *num_vectors_out = num_vectors;
         }
         return target;
     }
     
-    void get_xyz_in_place(const mxArray* matlab_struct, const unsigned index, const char* field_name, aiVector3D* target) {
-        aiVector3D* temp;
-        unsigned num_vectors = to_assimp_xyz(mxGetField(matlab_struct, index, field_name), &temp);
-        if (temp) {
-            target->x = temp->x;
-            target->y = temp->y;
-            target->z = temp->z;
-            delete [] temp;
-        }
+    void get_xyz_in_place(const mxArray* matlab_struct, const unsigned index, const int field_number, aiVector3D* target) {
+        get_first_floats(get_field(matlab_struct, index, field_number), &target->x, 3, true);
     }
     
-    void set_xyz(mxArray* matlab_struct, const unsigned index, const char* field_name, const aiVector3D* value, const unsigned num_vectors) {
+    void set_xyz(mxArray* matlab_struct, const unsigned index, const int field_number, const aiVector3D* value, const unsigned num_vectors, bool single_precision) {
         mxArray* xyz;
-        to_matlab_xyz(value, &xyz, num_vectors);
+        to_matlab_xyz(value, &xyz, num_vectors, single_precision);
         if (xyz) {
-            mxSetField(matlab_struct, index, field_name, xyz);
+            set_field(matlab_struct, index, field_number, xyz);
         }
     }
     
     // rgb to from struct
     
-    aiColor3D* get_rgb(const mxArray* matlab_struct, const unsigned index, const char* field_name, unsigned* num_vectors_out) {
-        aiColor3D* target;
-        unsigned num_vectors = to_assimp_rgb(mxGetField(matlab_struct, index, field_name), &target);
+    aiColor3D* get_rgb(const mxArray* matlab_struct, const unsigned index, const int field_number, unsigned* num_vectors_out) {
+        aiColor3D* target = 0;
+        unsigned num_vectors = to_assimp_rgb(get_field(matlab_struct, index, field_number), &target);
         if (num_vectors_out) {
             *num_vectors_out = num_vectors;
         }
         return target;
     }
     
-    void get_rgb_in_place(const mxArray* matlab_struct, const unsigned index, const char* field_name, aiColor3D* target) {
-        aiColor3D* temp;
-        unsigned num_vectors = to_assimp_rgb(mxGetField(matlab_struct, index, field_name), &temp);
-        if (temp) {
-            target->r = temp->r;
-            target->g = temp->g;
-            target->b = temp->b;
-            delete [] temp;
-        }
+    void get_rgb_in_place(const mxArray* matlab_struct, const unsigned index, const int field_number, aiColor3D* target) {
+        get_first_floats(get_field(matlab_struct, index, field_number), &target->r, 3, true);
     }
     
-    void set_rgb(mxArray* matlab_struct, const unsigned index, const char* field_name, const aiColor3D* value, const unsigned num_vectors) {
+    void set_rgb(mxArray* matlab_struct, const unsigned index, const int field_number, const aiColor3D* value, const unsigned num_vectors, bool single_precision) {
         mxArray* rgb;
-        to_matlab_rgb(value, &rgb, num_vectors);
+        to_matlab_rgb(value, &rgb, num_vectors, single_precision);
         if (rgb) {
-            mxSetField(matlab_struct, index, field_name, rgb);
+            set_field(matlab_struct, index, field_number, rgb);
         }
     }
     
     // rgba to from struct
     
-    aiColor4D* get_rgba(const mxArray* matlab_struct, const unsigned index, const char* field_name, unsigned* num_vectors_out) {
-        aiColor4D* target;
-        unsigned num_vectors = to_assimp_rgba(mxGetField(matlab_struct, index, field_name), &target);
+    aiColor4D* get_rgba(const mxArray* matlab_struct, const unsigned index, const int field_number, unsigned* num_vectors_out) {
+        aiColor4D* target = 0;
+        unsigned num_vectors = to_assimp_rgba(get_field(matlab_struct, index, field_number), &target);
         if (num_vectors_out) {
             *num_vectors_out = num_vectors;
         }
         return target;
     }
     
-    void set_rgba(mxArray* matlab_struct, const unsigned index, const char* field_name, const aiColor4D* value, const unsigned num_vectors) {
+    void set_rgba(mxArray* matlab_struct, const unsigned index, const int field_number, const aiColor4D* value, const unsigned num_vectors, bool single_precision) {
         mxArray* rgba;
-        to_matlab_rgba(value, &rgba, num_vectors);
+        to_matlab_rgba(value, &rgba, num_vectors, single_precision);
         if (rgba) {
-            mxSetField(matlab_struct, index, field_name, rgba);
+            set_field(matlab_struct, index, field_number, rgba);
         }
     }
     
     // texel to from struct
     
-    aiTexel* get_texel(const mxArray* matlab_struct, const unsigned index, const char* field_name, unsigned* num_vectors_out) {
-        aiTexel* target;
-        unsigned num_vectors = to_assimp_texel(mxGetField(matlab_struct, index, field_name), &target);
+    aiTexel* get_texel(const mxArray* matlab_struct, const unsigned index, const int field_number, unsigned* num_vectors_out) {
+        aiTexel* target = 0;
+        unsigned num_vectors = to_assimp_texel(get_field(matlab_struct, index, field_number), &target);
         if (num_vectors_out) {
             *num_vectors_out = num_vectors;
         }
         return target;
     }
     
-    void set_texel(mxArray* matlab_struct, const unsigned index, const char* field_name, const aiTexel* value, const unsigned width, const unsigned height) {
+    void set_texel(mxArray* matlab_struct, const unsigned index, const int field_number, const aiTexel* value, const unsigned width, const unsigned height) {
         mxArray* texel;
         to_matlab_texel(value, &texel, width, height);
         if (texel) {
-            mxSetField(matlab_struct, index, field_name, texel);
+            set_field(matlab_struct, index, field_number, texel);
         }
     }
     
     // 4x4 to from struct
     
-    aiMatrix4x4* get_4x4(const mxArray* matlab_struct, const unsigned index, const char* field_name, unsigned* num_vectors_out) {
-        aiMatrix4x4* target;
-        unsigned num_vectors = to_assimp_4x4(mxGetField(matlab_struct, index, field_name), &target);
+    aiMatrix4x4* get_4x4(const mxArray* matlab_struct, const unsigned index, const int field_number, unsigned* num_vectors_out) {
+        aiMatrix4x4* target = 0;
+        unsigned num_vectors = to_assimp_4x4(get_field(matlab_struct, index, field_number), &target);
         if (num_vectors_out) {
             *num_vectors_out = num_vectors;
         }
         return target;
     }
     
-    void get_4x4_in_place(const mxArray* matlab_struct, const unsigned index, const char* field_name, aiMatrix4x4* target) {
-        aiMatrix4x4* temp;
-        unsigned num_vectors = to_assimp_4x4(mxGetField(matlab_struct, index, field_name), &temp);
-        if (temp) {
-            target->a1 = temp->a1;
-            target->a2 = temp->a2;
-            target->a3 = temp->a3;
-            target->a4 = temp->a4;
-
-            target->b1 = temp->b1;
-            target->b2 = temp->b2;
-            target->b3 = temp->b3;
-            target->b4 = temp->b4;
-            
-            target->c1 = temp->c1;
-            target->c2 = temp->c2;
-            target->c3 = temp->c3;
-            target->c4 = temp->c4;
-            
-            target->d1 = temp->d1;
-            target->d2 = temp->d2;
-            target->d3 = temp->d3;
-            target->d4 = temp->d4;
-            
-            delete [] temp;
-        }
-    }
-    
-    void set_4x4(mxArray* matlab_struct, const unsigned index, const char* field_name, const aiMatrix4x4* value, const unsigned num_vectors) {
+    void get_4x4_in_place(const mxArray* matlab_struct, const unsigned index, const int field_number, aiMatrix4x4* target) {
+        // same memory order, Assimp rows become Matlab columns
+        get_first_floats(get_field(matlab_struct, index, field_number), &target->a1, 16, false);
+    }
+    
+    void set_4x4(mxArray* matlab_struct, const unsigned index, const int field_number, const aiMatrix4x4* value, const unsigned num_vectors) {
         mxArray* matlab_4x4;
         to_matlab_4x4(value, &matlab_4x4, num_vectors);
         if (matlab_4x4) {
-            mxSetField(matlab_struct, index, field_name, matlab_4x4);
+            set_field(matlab_struct, index, field_number, matlab_4x4);
         }
     }
     
     // material property data to from struct
     
-    char* get_property_data(const mxArray* matlab_struct, const unsigned index, const char* field_name, aiPropertyTypeInfo type_code, unsigned* num_bytes_out) {
+    // property data lives in the arena when there is one, otherwise it must be new char[] so Assimp knows how to free it later
+    static char* new_bytes(unsigned num_bytes, arena* scene_arena) {
+        if (scene_arena) {
+            return (char*)scene_arena->allocate(num_bytes);
+        }
+        return new char[num_bytes];
+    }
+    
+    char* get_property_data(const mxArray* matlab_struct, const unsigned index, const int field_number, aiPropertyTypeInfo type_code, unsigned* num_bytes_out, arena* scene_arena) {
         
         if (num_bytes_out) {
             *num_bytes_out = 0;
         }
         
-        // get data and copy to a char array.
-        // must use new char[] so that Assimp knows how to free it later.
+        // copy Matlab data straight into a char array, without a typed temporary
+        const mxArray* field = get_field(matlab_struct, index, field_number);
         unsigned num_elements;
         unsigned num_bytes;
         char* target;
         switch (type_code) {
             case aiPTI_Float: {
-                float* floats = get_floats(matlab_struct, index, field_name, &num_elements);
+                bool is_double = field && mxIsDouble(field) && mxGetPr(field);
+                num_elements = is_double ? mxGetNumberOfElements(field) : 0;
                 num_bytes = num_elements * sizeof(float);
-                target = new char[num_bytes];
-                memcpy(target, floats, num_bytes);
-                delete [] floats;
+                target = new_bytes(num_bytes, scene_arena);
+                if (is_double) {
+                    narrow_doubles(mxGetPr(field), (float*)target, num_elements);
+                }
                 break;
             }
             case aiPTI_String: {
                 // Assimp encodes strings as 4-byte-length + data + null
                 // https://github.com/assimp/assimp/blob/master/code/MaterialSystem.cpp#L268
-                const char* string = get_c_string(matlab_struct, index, field_name, "");
+                const char* string = get_c_string(matlab_struct, index, field_number, "");
                 uint32_T length = strlen(string);
                 num_bytes = 4 + length + 1;
-                target = new char[num_bytes];
+                target = new_bytes(num_bytes, scene_arena);
                 memcpy(target, &length, 4);
                 memcpy(target + 4, string, length);
                 target[num_bytes-1] = 0;
                 break;
             }
             case aiPTI_Integer: {
-                int* ints = get_ints(matlab_struct, index, field_name, &num_elements);
+                bool is_int = field && mxIsInt32(field) && mxGetData(field);
+                num_elements = is_int ? mxGetNumberOfElements(field) : 0;
                 num_bytes = num_elements * sizeof(int32_T);
-                target = new char[num_bytes];
-                memcpy(target, ints, num_bytes);
-                delete [] ints;
+                target = new_bytes(num_bytes, scene_arena);
+                if (is_int) {
+                    memcpy(target, mxGetData(field), num_bytes);
+                }
                 break;
             }
             case aiPTI_Buffer:
                 // fall through to default
             default: {
-                target = get_bytes(matlab_struct, index, field_name, &num_elements);
-                num_bytes = num_elements;
+                if (!field || !mxGetData(field)) {
+                    return 0;
+                }
+                num_bytes = mxGetNumberOfElements(field);
+                target = new_bytes(num_bytes, scene_arena);
+                memcpy(target, mxGetData(field), num_bytes);
                 break;
             }
         }
@@ -836,7 +828,7 @@ namespace mexximp {
         return target;
     }
     
-    void set_property_data(mxArray* matlab_struct, const unsigned index, const char* field_name, const char* value,  aiPropertyTypeInfo type_code, unsigned num_bytes) {
+    void set_property_data(mxArray* matlab_struct, const unsigned index, const int field_number, const char* value,  aiPropertyTypeInfo type_code, unsigned num_bytes) {
         if (!num_bytes) {
             return;
         }
@@ -845,22 +837,49 @@ namespace mexximp {
         switch (type_code) {
             case aiPTI_Float:
                 num_elements = num_bytes / sizeof(float);
-                set_floats(matlab_struct, index, field_name, (float*)value, num_elements);
+                set_floats(matlab_struct, index, field_number, (float*)value, num_elements);
                 return;
             case aiPTI_String:
                 // Assimp encodes strings as 4-byte-length + data + null
                 // https://github.com/assimp/assimp/blob/master/code/MaterialSystem.cpp#L268
-                set_c_string(matlab_struct, index, field_name, &value[4]);
+                set_c_string(matlab_struct, index, field_number, &value[4]);
                 return;
             case aiPTI_Integer:
                 num_elements = num_bytes / sizeof(int32_T);
-                set_ints(matlab_struct, index, field_name, (int32_T*)value, num_elements);
+                set_ints(matlab_struct, index, field_number, (int32_T*)value, num_elements);
                 return;
             case aiPTI_Buffer:
                 // fall through to default
             default:
-                set_bytes(matlab_struct, index, field_name, (char*)value, num_bytes);
+                set_bytes(matlab_struct, index, field_number, (char*)value, num_bytes);
                 return;
         }
     }
+    
+    // memory used
+    
+    size_t array_bytes(const mxArray* matlab_array) {
+        if (!matlab_array) {
+            return 0;
+        }
+        
+        size_t num_elements = mxGetNumberOfElements(matlab_array);
+        size_t bytes = sizeof(mxArray*);
+        if (mxIsStruct(matlab_array)) {
+            unsigned num_fields = mxGetNumberOfFields(matlab_array);
+            for (size_t i = 0; i < num_elements; i++) {
+                for (unsigned f = 0; f < num_fields; f++) {
+                    bytes += array_bytes(mxGetFieldByNumber(matlab_array, i, f));
+                }
+            }
+        } else if (mxIsCell(matlab_array)) {
+            for (size_t i = 0; i < num_elements; i++) {
+                bytes += array_bytes(mxGetCell(matlab_array, i));
+            }
+        } else {
+            size_t data_bytes = num_elements * mxGetElementSize(matlab_array);
+            bytes += mxIsComplex(matlab_array) ? 2 * data_bytes : data_bytes;
+        }
+        return bytes;
+    }
 }
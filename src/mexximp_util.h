@@ -16,6 +16,7 @@
 #include <assimp/scene.h>
 #include <assimp/texture.h>
 #include <assimp/types.h>
+#include "mexximp_arena.h"
 
 namespace mexximp {
     
@@ -28,19 +29,43 @@ namespace mexximp {
         return mxCreateCharArray(2, &dims[0]);
     }
     
+    // struct fields by number, resolved once per struct array instead of once per element
+
+    inline int field_number(const mxArray* matlab_struct, const char* field_name) {
+        if (!matlab_struct || !mxIsStruct(matlab_struct)) {
+            return -1;
+        }
+        return mxGetFieldNumber(matlab_struct, field_name);
+    }
+
+    inline mxArray* get_field(const mxArray* matlab_struct, const unsigned index, const int field_number) {
+        if (!matlab_struct || 0 > field_number) {
+            return 0;
+        }
+        return mxGetFieldByNumber(matlab_struct, index, field_number);
+    }
+
+    inline void set_field(mxArray* matlab_struct, const unsigned index, const int field_number, mxArray* value) {
+        if (!matlab_struct || 0 > field_number) {
+            mxDestroyArray(value);
+            return;
+        }
+        mxSetFieldByNumber(matlab_struct, index, field_number, value);
+    }
+
     // basic Assimp type conversions
-    
+
     unsigned to_assimp_xyz(const mxArray* matlab_xyz, aiVector3D** assimp_xyz);
-    unsigned to_matlab_xyz(const aiVector3D* assimp_xyz, mxArray** matlab_xyz, unsigned num_vectors);
+    unsigned to_matlab_xyz(const aiVector3D* assimp_xyz, mxArray** matlab_xyz, unsigned num_vectors, bool single_precision = false);
     
     unsigned to_assimp_string(const mxArray* matlab_string, aiString* assimp_string);
     unsigned to_matlab_string(const aiString* assimp_string, mxArray** matlab_string);
     
     unsigned to_assimp_rgb(const mxArray* matlab_rgb, aiColor3D** assimp_rgb);
-    unsigned to_matlab_rgb(const aiColor3D* assimp_rgb, mxArray** matlab_rgb, unsigned num_vectors);
+    unsigned to_matlab_rgb(const aiColor3D* assimp_rgb, mxArray** matlab_rgb, unsigned num_vectors, bool single_precision = false);
     
     unsigned to_assimp_rgba(const mxArray* matlab_rgba, aiColor4D** assimp_rgba);
-    unsigned to_matlab_rgba(const aiColor4D* assimp_rgba, mxArray** matlab_rgba, unsigned num_vectors);
+    unsigned to_matlab_rgba(const aiColor4D* assimp_rgba, mxArray** matlab_rgba, unsigned num_vectors, bool single_precision = false);
     
     unsigned to_assimp_texel(const mxArray* matlab_texel, aiTexel** assimp_texel);
     unsigned to_matlab_texel(const aiTexel* assimp_texel, mxArray** matlab_texel, unsigned width, unsigned height);
@@ -50,46 +75,49 @@ namespace mexximp {
     
     // data to and from Matlab structs
     
-    float get_scalar(const mxArray* matlab_struct, const unsigned index, const char* field_name, const float default_value);
-    void set_scalar(mxArray* matlab_struct, const unsigned index, const char* field_name, const float value);
+    float get_scalar(const mxArray* matlab_struct, const unsigned index, const int field_number, const float default_value);
+    void set_scalar(mxArray* matlab_struct, const unsigned index, const int field_number, const float value);
     
-    float* get_floats(const mxArray* matlab_struct, const unsigned index, const char* field_name, unsigned* num_elements_out);
-    void set_floats(mxArray* matlab_struct, const unsigned index, const char* field_name, const float* floats, unsigned num_elements);    
+    float* get_floats(const mxArray* matlab_struct, const unsigned index, const int field_number, unsigned* num_elements_out);
+    void set_floats(mxArray* matlab_struct, const unsigned index, const int field_number, const float* floats, unsigned num_elements);    
     
-    int32_T* get_ints(const mxArray* matlab_struct, const unsigned index, const char* field_name, unsigned* num_elements_out);
-    void set_ints(mxArray* matlab_struct, const unsigned index, const char* field_name, const int32_T* ints, unsigned num_elements);
+    int32_T* get_ints(const mxArray* matlab_struct, const unsigned index, const int field_number, unsigned* num_elements_out);
+    void set_ints(mxArray* matlab_struct, const unsigned index, const int field_number, const int32_T* ints, unsigned num_elements);
     
-    uint32_T* get_indices(const mxArray* matlab_struct, const unsigned index, const char* field_name, unsigned* num_elements_out);
-    void set_indices(mxArray* matlab_struct, const unsigned index, const char* field_name, const uint32_T* indices, unsigned num_elements);
+    uint32_T* get_indices(const mxArray* matlab_struct, const unsigned index, const int field_number, unsigned* num_elements_out);
+    void set_indices(mxArray* matlab_struct, const unsigned index, const int field_number, const uint32_T* indices, unsigned num_elements);
     
-    char* get_bytes(const mxArray* matlab_struct, const unsigned index, const char* field_name, unsigned* num_elements_out);
-    void set_bytes(mxArray* matlab_struct, const unsigned index, const char* field_name, const char* bytes, unsigned num_elements);
+    char* get_bytes(const mxArray* matlab_struct, const unsigned index, const int field_number, unsigned* num_elements_out);
+    void set_bytes(mxArray* matlab_struct, const unsigned index, const int field_number, const char* bytes, unsigned num_elements);
     
-    unsigned get_string(const mxArray* matlab_struct, const unsigned index, const char* field_name, aiString* target, const char* default_value);
-    void set_string(mxArray* matlab_struct, const unsigned index, const char* field_name, const aiString* value);
-    const char* get_c_string(const mxArray* matlab_struct, const unsigned index, const char* field_name, const char* default_value);
-    void set_c_string(mxArray* matlab_struct, const unsigned index, const char* field_name, const char* value);
+    unsigned get_string(const mxArray* matlab_struct, const unsigned index, const int field_number, aiString* target, const char* default_value);
+    void set_string(mxArray* matlab_struct, const unsigned index, const int field_number, const aiString* value);
+    const char* get_c_string(const mxArray* matlab_struct, const unsigned index, const int field_number, const char* default_value);
+    void set_c_string(mxArray* matlab_struct, const unsigned index, const int field_number, const char* value);
     
-    aiVector3D* get_xyz(const mxArray* matlab_struct, const unsigned index, const char* field_name, unsigned* num_vectors_out);
-    void get_xyz_in_place(const mxArray* matlab_struct, const unsigned index, const char* field_name, aiVector3D* target);
-    void set_xyz(mxArray* matlab_struct, const unsigned index, const char* field_name, const aiVector3D* value, const unsigned num_vectors);
+    aiVector3D* get_xyz(const mxArray* matlab_struct, const unsigned index, const int field_number, unsigned* num_vectors_out);
+    void get_xyz_in_place(const mxArray* matlab_struct, const unsigned index, const int field_number, aiVector3D* target);
+    void set_xyz(mxArray* matlab_struct, const unsigned index, const int field_number, const aiVector3D* value, const unsigned num_vectors, bool single_precision = false);
     
-    aiColor3D* get_rgb(const mxArray* matlab_struct, const unsigned index, const char* field_name, unsigned* num_vectors_out);
-    void get_rgb_in_place(const mxArray* matlab_struct, const unsigned index, const char* field_name, aiColor3D* target);
-    void set_rgb(mxArray* matlab_struct, const unsigned index, const char* field_name, const aiColor3D* value, const unsigned num_vectors);
+    aiColor3D* get_rgb(const mxArray* matlab_struct, const unsigned index, const int field_number, unsigned* num_vectors_out);
+    void get_rgb_in_place(const mxArray* matlab_struct, const unsigned index, const int field_number, aiColor3D* target);
+    void set_rgb(mxArray* matlab_struct, const unsigned index, const int field_number, const aiColor3D* value, const unsigned num_vectors, bool single_precision = false);
     
-    aiColor4D* get_rgba(const mxArray* matlab_struct, const unsigned index, const char* field_name, unsigned* num_vectors_out);
-    void set_rgba(mxArray* matlab_struct, const unsigned index, const char* field_name, const aiColor4D* value, const unsigned num_vectors);
+    aiColor4D* get_rgba(const mxArray* matlab_struct, const unsigned index, const int field_number, unsigned* num_vectors_out);
+    void set_rgba(mxArray* matlab_struct, const unsigned index, const int field_number, const aiColor4D* value, const unsigned num_vectors, bool single_precision = false);
 
-    aiTexel* get_texel(const mxArray* matlab_struct, const unsigned index, const char* field_name, unsigned* num_vectors_out);
-    void set_texel(mxArray* matlab_struct, const unsigned index, const char* field_name, const aiTexel* value, const unsigned width, const unsigned height);
+    aiTexel* get_texel(const mxArray* matlab_struct, const unsigned index, const int field_number, unsigned* num_vectors_out);
+    void set_texel(mxArray* matlab_struct, const unsigned index, const int field_number, const aiTexel* value, const unsigned width, const unsigned height);
+    
+    aiMatrix4x4* get_4x4(const mxArray* matlab_struct, const unsigned index, const int field_number, unsigned* num_vectors_out);
+    void get_4x4_in_place(const mxArray* matlab_struct, const unsigned index, const int field_number, aiMatrix4x4* target);
+    void set_4x4(mxArray* matlab_struct, const unsigned index, const int field_number, const aiMatrix4x4* value, const unsigned num_vectors);
     
-    aiMatrix4x4* get_4x4(const mxArray* matlab_struct, const unsigned index, const char* field_name, unsigned* num_vectors_out);
-    void get_4x4_in_place(const mxArray* matlab_struct, const unsigned index, const char* field_name, aiMatrix4x4* target);
-    void set_4x4(mxArray* matlab_struct, const unsigned index, const char* field_name, const aiMatrix4x4* value, const unsigned num_vectors);
+    char* get_property_data(const mxArray* matlab_struct, const unsigned index, const int field_number, aiPropertyTypeInfo type_code, unsigned* num_bytes_out, arena* scene_arena = 0);
+    void set_property_data(mxArray* matlab_struct, const unsigned index, const int field_number, const char* value,  aiPropertyTypeInfo type_code, unsigned num_bytes);    
     
-    char* get_property_data(const mxArray* matlab_struct, const unsigned index, const char* field_name, aiPropertyTypeInfo type_code, unsigned* num_bytes_out);
-    void set_property_data(mxArray* matlab_struct, const unsigned index, const char* field_name, const char* value,  aiPropertyTypeInfo type_code, unsigned num_bytes);    
+    // approximate memory used by a Matlab array and all its fields and cells
+    size_t array_bytes(const mxArray* matlab_array);
 }
 
 #endif  // MEXXIMP_UTIL_H_
@@ -63,6 +63,79 @@ classdef MexximpExportTests < matlab.unittest.TestCase
             testCase.assertMaterialsAboutEqual(scenePrime.materials, scene.materials);
         end
         
+        function testExportTargets(testCase)
+            scene = mexximpImport(testCase.sampleFile);
+            
+            targets = mexximpConstants('exportTarget');
+            targets(1).format = 'collada';
+            targets(1).file = fullfile(tempdir(), 'targets.dae');
+            targets(2).format = 'obj';
+            targets(2).file = fullfile(tempdir(), 'targets.obj');
+            targets(2).postprocessSteps = testCase.postprocessorSteps;
+            targets(3).format = 'no-such-format';
+            targets(3).file = fullfile(tempdir(), 'targets.nope');
+            
+            exportOptions = mexximpConstants('exportOption');
+            exportOptions.numThreads = 0;
+            [status, errors] = mexximpExport(scene, targets, exportOptions);
+            
+            testCase.assertEqual(status(1:2), [0 0]);
+            testCase.assertNotEqual(status(3), 0);
+            testCase.assertEmpty(errors{1});
+            testCase.assertNotEmpty(errors{3});
+            testCase.assertEqual(exist(targets(1).file, 'file'), 2);
+            testCase.assertEqual(exist(targets(2).file, 'file'), 2);
+            
+            % same scene as exporting one target at a time
+            sceneOne = mexximpImport(targets(1).file);
+            mexximpExport(scene, 'collada', targets(1).file);
+            testCase.assertEqual(sceneOne, mexximpImport(targets(1).file));
+        end
+        
+        function testExportToBlob(testCase)
+            scene = mexximpImport(testCase.sampleFile);
+            
+            exportOptions = mexximpConstants('exportOption');
+            testCase.assertFalse(exportOptions.toBlob);
+            exportOptions.toBlob = true;
+            
+            blobFile = fullfile(tempdir(), 'blob.dae');
+            if exist(blobFile, 'file')
+                delete(blobFile);
+            end
+            [status, blobs] = mexximpExport(scene, 'collada', blobFile, [], exportOptions);
+            testCase.assertEqual(status, 0);
+            testCase.assertEqual(exist(blobFile, 'file'), 0);
+            testCase.assertEqual(blobs(1).name, 'blob.dae');
+            testCase.assertClass(blobs(1).data, 'uint8');
+            
+            % same scene as a file export
+            mexximpExport(scene, 'collada', blobFile);
+            testCase.assertEqual(mexximpImport(blobs(1).data, [], [], 'dae'), mexximpImport(blobFile));
+            
+            % side files come back as more blobs
+            [status, blobs] = mexximpExport(scene, 'obj', fullfile(tempdir(), 'blob.obj'), [], exportOptions);
+            testCase.assertEqual(status, 0);
+            testCase.assertEqual({blobs.name}, {'blob.obj', 'blob.mtl'});
+        end
+        
+        function testExportTiming(testCase)
+            scene = mexximpImport(testCase.sampleFile);
+            
+            timingFile = fullfile(tempdir(), 'timing.dae');
+            [status, ~, timing] = mexximpExport(scene, 'collada', timingFile);
+            testCase.assertEqual(status, 0);
+            testCase.assertEqual({timing.name}, ...
+                {'cameras', 'lights', 'materials', 'meshes', 'nodes', 'textures', 'export'});
+            testCase.assertEqual(timing(4).count, numel(scene.meshes));
+            testCase.assertGreaterThan(timing(4).bytes, 0);
+            testCase.assertEqual(timing(end).count, 1);
+            fileInfo = dir(timingFile);
+            testCase.assertEqual(timing(end).bytes, fileInfo.bytes);
+            testCase.assertGreaterThanOrEqual([timing.wallSeconds], 0);
+            testCase.assertGreaterThanOrEqual([timing.cpuSeconds], 0);
+        end
+        
         function testExportExample(testCase)
             outputFile = fullfile(tempdir(), 'scratch-example.dae');
             [scene, outputFile, status] = exportTestScene( ...
@@ -76,6 +149,38 @@ classdef MexximpExportTests < matlab.unittest.TestCase
             testCase.assertNotEmpty(scene.cameras);
             testCase.assertEqual(exist(outputFile, 'file'), 2);
         end
+        
+        function testWriteBinaryPly(testCase)
+            nVertices = 1000;
+            nFaces = 2000;
+            xyz = rand(3, nVertices);
+            normals = rand(3, nVertices, 'single');
+            uvs = rand(2, nVertices);
+            faces = randi(nVertices, 3, nFaces, 'uint32') - 1;
+            
+            outputFile = fullfile(tempdir(), 'binary.ply');
+            mexximpWriteTriangleMeshPly(outputFile, xyz, faces, ...
+                'normals', normals, ...
+                'uvs', uvs, ...
+                'format', 'binary_little_endian');
+            
+            % read back the header, then the float32 vertex and uint32 face records
+            fid = fopen(outputFile, 'r', 'ieee-le');
+            header = {};
+            while isempty(header) || ~strcmp(header{end}, 'end_header')
+                header{end+1} = fgetl(fid);
+            end
+            vertexData = fread(fid, [8 nVertices], 'float32=>single');
+            faceData = fread(fid, [4 nFaces], 'uint32=>uint32');
+            fclose(fid);
+            
+            testCase.assertEqual(header{2}, 'format binary_little_endian 1.0');
+            testCase.assertEqual(header{3}, sprintf('element vertex %d', nVertices));
+            testCase.assertEqual(vertexData(1:3,:), single(xyz));
+            testCase.assertEqual(vertexData(4:6,:), normals);
+            testCase.assertEqual(vertexData(7:8,:), single(uvs));
+            testCase.assertEqual(faceData, [3 + zeros(1, nFaces, 'uint32'); faces]);
+        end
     end
     
     methods
@@ -113,6 +113,56 @@ classdef MexximpFlattenNodesTests < matlab.unittest.TestCase
             testCase.assertEqual(numel(info.path), 3);
         end
         
+        function testNestedWorldTransforms(testCase)
+            scene = testCase.loadNestedScene();
+            
+            % native world transforms should match the recursive traversal
+            [worldTransforms, parents] = mexximpNodes('world', scene);
+            expected = mexximpVisitNodes(scene, ...
+                @(scene, node, childResults, workingTransformation) cat(3, workingTransformation, childResults{:}));
+            testCase.assertEqual(worldTransforms, expected, 'AbsTol', 1e-12);
+            testCase.assertEqual(parents(1), int32(-1));
+            testCase.assertNumElements(parents, size(worldTransforms, 3));
+            
+            % flattened children carry the same transforms
+            flattened = mexximpFlattenNodes(scene);
+            testCase.assertEqual(cat(3, flattened.children.transformation), worldTransforms(:,:,2:end), ...
+                'AbsTol', 1e-12);
+        end
+        
+        function testNestedSceneBox(testCase)
+            scene = testCase.loadNestedScene();
+            
+            % box around transformed corners contains all transformed vertices
+            [worldTransforms, ~] = mexximpNodes('world', scene);
+            nodeInfo = mexximpNodePaths(scene);
+            allVertices = zeros(3, 0);
+            for nn = 1:numel(nodeInfo)
+                node = mPathGet(scene, nodeInfo(nn).path);
+                for mm = 1:numel(node.meshIndices)
+                    vertices = scene.meshes(node.meshIndices(mm) + 1).vertices;
+                    allVertices = cat(2, allVertices, ...
+                        mexximpApplyTransform(vertices, worldTransforms(:,:,nn)));
+                end
+            end
+            
+            [sceneBox, middlePoint] = mexximpSceneBox(scene);
+            testCase.assertSize(sceneBox, [3 2]);
+            testCase.assertLessThanOrEqual(sceneBox(:,1), min(allVertices, [], 2) + 1e-6);
+            testCase.assertGreaterThanOrEqual(sceneBox(:,2), max(allVertices, [], 2) - 1e-6);
+            testCase.assertEqual(middlePoint, mean(sceneBox, 2));
+            
+            % root box covers every node box
+            [rootBox, nodeBoxes, meshBoxes] = mexximpNodes('bounds', scene);
+            testCase.assertEqual(rootBox, sceneBox);
+            testCase.assertSize(nodeBoxes, [3 2 numel(nodeInfo)]);
+            testCase.assertSize(meshBoxes, [3 2 numel(scene.meshes)]);
+            
+            % ignoring every node leaves nothing to bound
+            ignoreNodes = {nodeInfo.name};
+            testCase.assertEmpty(mexximpSceneBox(scene, 'ignoreNodes', ignoreNodes));
+        end
+        
         function testFlatNoChildren(testCase)
             scene = testCase.loadFlatScene();
             
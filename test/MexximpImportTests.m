@@ -45,5 +45,333 @@ classdef MexximpImportTests < matlab.unittest.TestCase
 
         end
         
+        function testImportPackedFaces(testCase)
+            options = mexximpConstants('importOption');
+            options.packedFaces = true;
+            packedScene = mexximpImport(testCase.sampleFile, [], options);
+            testCase.assertNotEmpty(packedScene);
+            
+            scene = mexximpImport(testCase.sampleFile);
+            testCase.assertNumElements(packedScene.meshes, numel(scene.meshes));
+            
+            for mm = 1:numel(scene.meshes)
+                faces = scene.meshes(mm).faces;
+                packedFaces = packedScene.meshes(mm).faces;
+                if isnumeric(packedFaces)
+                    % one column per face
+                    testCase.assertClass(packedFaces, 'uint32');
+                    testCase.assertEqual(packedFaces(:)', [faces.indices]);
+                    testCase.assertEqual(size(packedFaces), [faces(1).nIndices, numel(faces)]);
+                else
+                    % compressed rows of indices
+                    testCase.assertEqual(packedFaces.faceIndices, [faces.indices]);
+                    testCase.assertEqual(diff(double(packedFaces.faceOffsets)), [faces.nIndices]);
+                end
+            end
+        end
+        
+        function testImportSinglePrecision(testCase)
+            options = mexximpConstants('importOption');
+            options.singlePrecision = true;
+            singleScene = mexximpImport(testCase.sampleFile, [], options);
+            testCase.assertNotEmpty(singleScene);
+            
+            scene = mexximpImport(testCase.sampleFile);
+            testCase.assertNumElements(singleScene.meshes, numel(scene.meshes));
+            
+            for mm = 1:numel(scene.meshes)
+                testCase.assertClass(singleScene.meshes(mm).vertices, 'single');
+                testCase.assertClass(singleScene.meshes(mm).normals, 'single');
+                testCase.assertClass(singleScene.meshes(mm).colors0, 'single');
+                testCase.assertClass(singleScene.meshes(mm).textureCoordinates0, 'single');
+                testCase.assertEqual(double(singleScene.meshes(mm).vertices), scene.meshes(mm).vertices);
+                testCase.assertEqual(double(singleScene.meshes(mm).normals), scene.meshes(mm).normals);
+            end
+        end
+        
+        function testImportMeshFields(testCase)
+            scene = mexximpImport(testCase.sampleFile);
+            
+            options = mexximpConstants('importOption');
+            testCase.assertEqual(options.meshFields, fieldnames(scene.meshes)');
+            
+            options.meshFields = {'vertices', 'normals', 'textureCoordinates0', 'faces'};
+            maskedScene = mexximpImport(testCase.sampleFile, [], options);
+            testCase.assertNumElements(maskedScene.meshes, numel(scene.meshes));
+            
+            % required fields come along, in the usual order
+            expectedFields = {'name', 'materialIndex', 'primitiveTypes', ...
+                'vertices', 'faces', 'normals', 'textureCoordinates0'};
+            testCase.assertEqual(fieldnames(maskedScene.meshes)', expectedFields);
+            
+            for mm = 1:numel(scene.meshes)
+                for ff = 1:numel(expectedFields)
+                    field = expectedFields{ff};
+                    testCase.assertEqual(maskedScene.meshes(mm).(field), scene.meshes(mm).(field));
+                end
+            end
+        end
+        
+        function testImportMeshBounds(testCase)
+            options = mexximpConstants('importOption');
+            options.meshBounds = true;
+            scene = mexximpImport(testCase.sampleFile, [], options);
+            
+            for mm = 1:numel(scene.meshes)
+                vertices = scene.meshes(mm).vertices;
+                testCase.assertEqual(scene.meshes(mm).bounds, ...
+                    [min(vertices, [], 2) max(vertices, [], 2)]);
+            end
+            
+            % native scene box uses the bounds field the same as vertices
+            testCase.assertEqual(mexximpSceneBox(scene), ...
+                mexximpSceneBox(mexximpImport(testCase.sampleFile)));
+        end
+        
+        function testImportCache(testCase)
+            mexximpImport('-cache', 'clear');
+            scene = mexximpImport(testCase.sampleFile);
+            
+            options = mexximpConstants('importOption');
+            options.useCache = true;
+            firstScene = mexximpImport(testCase.sampleFile, [], options);
+            secondScene = mexximpImport(testCase.sampleFile, [], options);
+            testCase.assertEqual(firstScene, scene);
+            testCase.assertEqual(secondScene, scene);
+            
+            info = mexximpImport('-cache');
+            testCase.assertNumElements(info.entries, 1);
+            testCase.assertEqual(info.entries.hits, 1);
+            testCase.assertEqual(info.totalBytes, info.entries.sceneBytes);
+            
+            % different layout gets its own entry
+            options.singlePrecision = true;
+            mexximpImport(testCase.sampleFile, [], options);
+            info = mexximpImport('-cache');
+            testCase.assertNumElements(info.entries, 2);
+            
+            % over budget evicts everything
+            info = mexximpImport('-cache', 'budget', 0);
+            testCase.assertEmpty(info.entries);
+            
+            mexximpImport('-cache', 'budget', 512 * 1024 * 1024);
+            mexximpImport(testCase.sampleFile, [], options);
+            info = mexximpImport('-cache', 'clear');
+            testCase.assertEmpty(info.entries);
+            testCase.assertEqual(info.totalBytes, 0);
+        end
+        
+        function testImportCacheRewrite(testCase)
+            mexximpImport('-cache', 'clear');
+            options = mexximpConstants('importOption');
+            options.useCache = true;
+            
+            % same size, rewritten right away, likely within the same second
+            objFile = fullfile(tempdir(), 'rewrite.obj');
+            MexximpImportTests.writeText(objFile, sprintf('v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n'));
+            firstScene = mexximpImport(objFile, [], options);
+            MexximpImportTests.writeText(objFile, sprintf('v 0 0 0\nv 2 0 0\nv 0 2 0\nf 1 2 3\n'));
+            secondScene = mexximpImport(objFile, [], options);
+            
+            testCase.assertEqual(max(firstScene.meshes(1).vertices(:)), 1);
+            testCase.assertEqual(max(secondScene.meshes(1).vertices(:)), 2);
+            mexximpImport('-cache', 'clear');
+        end
+        
+        function testImportThreads(testCase)
+            scene = mexximpImport(testCase.sampleFile);
+            
+            options = mexximpConstants('importOption');
+            options.packedFaces = true;
+            packedScene = mexximpImport(testCase.sampleFile, [], options);
+            
+            % same data with any number of threads, or 0 for one per CPU
+            for numThreads = [0 2 8]
+                options = mexximpConstants('importOption');
+                options.numThreads = numThreads;
+                threadedScene = mexximpImport(testCase.sampleFile, [], options);
+                testCase.assertEqual(threadedScene, scene);
+                
+                options.packedFaces = true;
+                threadedScene = mexximpImport(testCase.sampleFile, [], options);
+                testCase.assertEqual(threadedScene, packedScene);
+            end
+        end
+        
+        function testImportMemoryMap(testCase)
+            scene = mexximpImport(testCase.sampleFile);
+            
+            options = mexximpConstants('importOption');
+            testCase.assertFalse(options.memoryMap);
+            options.memoryMap = true;
+            mappedScene = mexximpImport(testCase.sampleFile, [], options);
+            testCase.assertEqual(mappedScene, scene);
+            
+            % batch and background imports map files too
+            mappedScenes = mexximpImport({testCase.sampleFile}, [], options);
+            testCase.assertEqual(mappedScenes, scene);
+            job = mexximpImport('-start', testCase.sampleFile, [], options);
+            testCase.assertEqual(mexximpImport('-fetch', job), scene);
+        end
+        
+        function testImportConfig(testCase)
+            scene = mexximpImport(testCase.sampleFile);
+            maxVertices = max(arrayfun(@(mesh) size(mesh.vertices, 2), scene.meshes));
+            
+            % a small vertex limit makes the split step split large meshes
+            steps = testCase.postprocessorSteps;
+            steps.splitLargeMeshes = true;
+            options = mexximpConstants('importOption');
+            testCase.assertEmpty(options.config);
+            limit = floor(maxVertices / 2);
+            options.config = struct( ...
+                'name', 'PP_SLM_VERTEX_LIMIT', ...
+                'type', 'integer', ...
+                'value', limit);
+            splitScene = mexximpImport(testCase.sampleFile, steps, options);
+            
+            testCase.assertGreaterThan(numel(splitScene.meshes), numel(scene.meshes));
+            for mesh = splitScene.meshes
+                testCase.assertLessThanOrEqual(size(mesh.vertices, 2), limit);
+            end
+            
+            % a whole double with no type is an integer, which is how Assimp reads the limit
+            options.config = struct( ...
+                'name', 'PP_SLM_VERTEX_LIMIT', ...
+                'value', limit);
+            untypedScene = mexximpImport(testCase.sampleFile, steps, options);
+            testCase.assertEqual(untypedScene, splitScene);
+        end
+        
+        function testImportConfigWholeFloat(testCase)
+            % drop normals, then make new ones with a float smoothing angle
+            steps = testCase.postprocessorSteps;
+            steps.removeComponent = true;
+            steps.generateSmoothNormals = true;
+            options = mexximpConstants('importOption');
+            options.config = struct( ...
+                'name', {'PP_RVC_FLAGS', 'PP_GSN_MAX_SMOOTHING_ANGLE'}, ...
+                'type', {'integer', 'float'}, ...
+                'value', {2, 0});
+            typedScene = mexximpImport(testCase.sampleFile, steps, options);
+            
+            % a whole number with no type still reaches Assimp as a float
+            options.config(2).type = '';
+            untypedScene = mexximpImport(testCase.sampleFile, steps, options);
+            testCase.assertEqual(untypedScene, typedScene);
+            
+            % and it's not just the default angle
+            options.config = options.config(1);
+            defaultScene = mexximpImport(testCase.sampleFile, steps, options);
+            testCase.assertNotEqual(defaultScene, typedScene);
+        end
+        
+        function testImportTiming(testCase)
+            scene = mexximpImport(testCase.sampleFile);
+            
+            % reading and postprocessing separately gives the same scene
+            steps = testCase.postprocessorSteps;
+            steps.triangulate = true;
+            [timedScene, timing] = mexximpImport(testCase.sampleFile, steps);
+            testCase.assertEqual(timedScene, mexximpImport(testCase.sampleFile, steps));
+            testCase.assertEqual({timing.name}, ...
+                {'read', 'postprocess', 'cameras', 'lights', 'materials', 'meshes', 'faces', 'nodes', 'textures'});
+            
+            meshes = timing(strcmp({timing.name}, 'meshes'));
+            testCase.assertEqual(meshes.count, numel(scene.meshes));
+            testCase.assertGreaterThan(meshes.bytes, 0);
+            faces = timing(strcmp({timing.name}, 'faces'));
+            testCase.assertEqual(faces.count, sum(arrayfun(@(mesh) numel(mesh.faces), timedScene.meshes)));
+            testCase.assertGreaterThanOrEqual([timing.wallSeconds], 0);
+            testCase.assertGreaterThanOrEqual([timing.cpuSeconds], 0);
+        end
+        
+        function testImportBatch(testCase)
+            scene = mexximpImport(testCase.sampleFile);
+            
+            % good files come back in order, bad files come back empty with an error
+            sceneFiles = {testCase.sampleFile, 'no-such-file.dae', testCase.sampleFile};
+            for numThreads = [0 1 2]
+                options = mexximpConstants('importOption');
+                options.numThreads = numThreads;
+                [scenes, status, errors] = mexximpImport(sceneFiles, [], options);
+                
+                testCase.assertSize(scenes, [1 3]);
+                testCase.assertEqual(status, [0 -1 0]);
+                testCase.assertEqual(scenes(1), scene);
+                testCase.assertEqual(scenes(3), scene);
+                testCase.assertEmpty(scenes(2).meshes);
+                testCase.assertEmpty(errors{1});
+                testCase.assertNotEmpty(errors{2});
+            end
+        end
+        
+        function testImportFromMemory(testCase)
+            scene = mexximpImport(testCase.sampleFile);
+            
+            fid = fopen(testCase.sampleFile, 'r');
+            sceneBytes = fread(fid, inf, 'uint8=>uint8');
+            fclose(fid);
+            memoryScene = mexximpImport(sceneBytes, [], [], 'dae');
+            testCase.assertEqual(memoryScene, scene);
+            
+            % an obj file finds its mtl file among the side files
+            objFile = fullfile(tempdir(), 'memory.obj');
+            mexximpExport(scene, 'obj', objFile);
+            objScene = mexximpImport(objFile);
+            
+            fid = fopen(objFile, 'r');
+            objBytes = fread(fid, inf, 'uint8=>uint8');
+            fclose(fid);
+            fid = fopen(fullfile(tempdir(), 'memory.mtl'), 'r');
+            mtlBytes = fread(fid, inf, 'uint8=>uint8');
+            fclose(fid);
+            
+            sideFiles = struct('name', 'memory.mtl', 'data', mtlBytes);
+            memoryScene = mexximpImport(objBytes, [], [], '.obj', sideFiles);
+            testCase.assertEqual(memoryScene.materials, objScene.materials);
+            testCase.assertEqual(memoryScene.meshes, objScene.meshes);
+        end
+        
+        function testImportJobs(testCase)
+            scene = mexximpImport(testCase.sampleFile);
+            
+            job = mexximpImport('-start', testCase.sampleFile);
+            info = mexximpImport('-poll', job);
+            testCase.assertEqual(info.id, job);
+            testCase.assertTrue(any(strcmp(info.state, {'running', 'finished'})));
+            
+            testCase.assertTrue(mexximpImport('-wait', job, 60));
+            info = mexximpImport('-poll', job);
+            testCase.assertEqual(info.state, 'finished');
+            testCase.assertEqual(info.progress, 1);
+            testCase.assertEqual(mexximpImport('-fetch', job), scene);
+            
+            % fetched jobs are forgotten
+            testCase.assertEmpty(mexximpImport('-poll', job));
+            
+            % failed jobs report an error
+            job = mexximpImport('-start', 'no-such-file.dae');
+            mexximpImport('-wait', job);
+            info = mexximpImport('-poll', job);
+            testCase.assertEqual(info.state, 'failed');
+            testCase.assertNotEmpty(info.error);
+            testCase.assertEmpty(mexximpImport('-fetch', job));
+            
+            % cancelled jobs are forgotten right away
+            job = mexximpImport('-start', testCase.sampleFile);
+            testCase.assertTrue(mexximpImport('-cancel', job));
+            testCase.assertEmpty(mexximpImport('-poll', job));
+            testCase.assertFalse(mexximpImport('-cancel', job));
+        end
+        
+    end
+    
+    methods (Static)
+        function writeText(fileName, text)
+            fid = fopen(fileName, 'w');
+            fwrite(fid, text);
+            fclose(fid);
+        end
     end
 end
@@ -119,6 +119,141 @@ classdef MexximpSceneTests < matlab.unittest.TestCase
             end
         end
         
+        function testPackedFacesRoundTrip(testCase)
+            options = mexximpConstants('importOption');
+            options.packedFaces = true;
+            
+            scene = testCase.emptyScene;
+            for s = testCase.itemSize
+                % one triangle per column
+                scene.meshes = struct( ...
+                    'name', MexximpSceneTests.randomString(s), ...
+                    'materialIndex', 0, ...
+                    'primitiveTypes', mexximpConstants('meshPrimitive'), ...
+                    'vertices', rand(3, s), ...
+                    'faces', randi(s, 3, s, 'uint32'));
+                scenePrime = mexximpTest('scene', scene, options);
+                testCase.assertEqual(scenePrime.meshes(1).faces, scene.meshes.faces);
+                
+                % faces of varying size, as offsets and indices
+                faceOffsets = uint32([0 cumsum(1:s)]);
+                faces = struct( ...
+                    'faceOffsets', faceOffsets, ...
+                    'faceIndices', randi(s, 1, faceOffsets(end), 'uint32'));
+                scene.meshes.faces = faces;
+                scenePrime = mexximpTest('scene', scene, options);
+                if 1 == s
+                    % a single face packs into a matrix
+                    testCase.assertEqual(scenePrime.meshes(1).faces, faces.faceIndices);
+                else
+                    testCase.assertEqual(scenePrime.meshes(1).faces, faces);
+                end
+                
+                % offsets built the natural way are double
+                scene.meshes.faces = struct( ...
+                    'faceOffsets', double(faces.faceOffsets), ...
+                    'faceIndices', double(faces.faceIndices));
+                doubleScenePrime = mexximpTest('scene', scene, options);
+                testCase.assertEqual(doubleScenePrime.meshes(1).faces, scenePrime.meshes(1).faces);
+            end
+        end
+        
+        function testThreadedMeshesRoundTrip(testCase)
+            exportOptions = mexximpConstants('exportOption');
+            exportOptions.numThreads = 4;
+            
+            scene = testCase.emptyScene;
+            for s = testCase.itemSize
+                % several meshes with packed faces
+                vertices = cell(1, s);
+                colors = cell(1, s);
+                faces = cell(1, s);
+                for ii = 1:s
+                    vertices{ii} = rand(3, ii);
+                    colors{ii} = rand(4, ii);
+                    faces{ii} = randi(ii, 3, ii, 'uint32');
+                end
+                scene.meshes = struct( ...
+                    'name', MexximpSceneTests.randomString(s), ...
+                    'materialIndex', 0, ...
+                    'primitiveTypes', mexximpConstants('meshPrimitive'), ...
+                    'vertices', vertices, ...
+                    'normals', vertices, ...
+                    'colors0', colors, ...
+                    'faces', faces);
+                
+                serialScene = mexximpTest('scene', scene);
+                threadedScene = mexximpTest('scene', scene, [], exportOptions);
+                testCase.assertEqual(threadedScene, serialScene);
+            end
+        end
+        
+        function testBorrowedSinglesRoundTrip(testCase)
+            exportOptions = mexximpConstants('exportOption');
+            testCase.assertTrue(exportOptions.borrowSingles);
+            
+            scene = testCase.emptyScene;
+            for s = testCase.itemSize
+                % single channels are borrowed, double channels are copied
+                scene.meshes = struct( ...
+                    'name', MexximpSceneTests.randomString(s), ...
+                    'materialIndex', 0, ...
+                    'primitiveTypes', mexximpConstants('meshPrimitive'), ...
+                    'vertices', rand(3, s, 'single'), ...
+                    'normals', rand(3, s), ...
+                    'colors0', rand(4, s, 'single'), ...
+                    'textureCoordinates0', rand(3, s, 'single'), ...
+                    'faces', randi(s, 3, s, 'uint32'));
+                
+                exportOptions.borrowSingles = true;
+                borrowedScene = mexximpTest('scene', scene, [], exportOptions);
+                exportOptions.borrowSingles = false;
+                copiedScene = mexximpTest('scene', scene, [], exportOptions);
+                testCase.assertEqual(borrowedScene, copiedScene);
+                testCase.assertEqual(borrowedScene.meshes.vertices, double(scene.meshes.vertices));
+                
+                % the Matlab data is left alone
+                testCase.assertClass(scene.meshes.vertices, 'single');
+                testCase.assertSize(scene.meshes.colors0, [4 s]);
+            end
+        end
+        
+        function testArenaRoundTrip(testCase)
+            exportOptions = mexximpConstants('exportOption');
+            testCase.assertTrue(exportOptions.arenaAllocation);
+            
+            scene = testCase.emptyScene;
+            for s = testCase.itemSize
+                keys = MexximpSceneTests.randomElements(s, testCase.materialPropertyKeys);
+                types = MexximpSceneTests.randomElements(s, testCase.dataTypes);
+                scene.materials = struct( ...
+                    'properties', struct( ...
+                    'key', keys, ...
+                    'dataType',  types, ...
+                    'data', MexximpSceneTests.randomDatas(s, types), ...
+                    'textureSemantic', MexximpSceneTests.randomElements(s, testCase.textureSemantics), ...
+                    'textureIndex', num2cell(randi([0 s], [1 s]))));
+                
+                % struct faces in one mesh, packed faces in the other
+                indices = cell(1, s);
+                for ii = 1:s
+                    indices{ii} = randi(s, 1, ii, 'uint32');
+                end
+                scene.meshes = struct( ...
+                    'name', {'structFaces', 'packedFaces'}, ...
+                    'materialIndex', 0, ...
+                    'primitiveTypes', mexximpConstants('meshPrimitive'), ...
+                    'vertices', rand(3, s), ...
+                    'faces', {struct('nIndices', num2cell(1:s), 'indices', indices), randi(s, 3, s, 'uint32')});
+                
+                exportOptions.arenaAllocation = true;
+                arenaScene = mexximpTest('scene', scene, [], exportOptions);
+                exportOptions.arenaAllocation = false;
+                heapScene = mexximpTest('scene', scene, [], exportOptions);
+                testCase.assertEqual(arenaScene, heapScene);
+            end
+        end
+        
         function testNodeRoundTrip(testCase)
             scene = testCase.emptyScene;
             for s = testCase.itemSize
@@ -138,6 +273,86 @@ classdef MexximpSceneTests < matlab.unittest.TestCase
             end
         end
         
+        function testFlatNodesRoundTrip(testCase)
+            options = mexximpConstants('importOption');
+            options.flatNodes = true;
+            
+            scene = testCase.emptyScene;
+            for s = testCase.itemSize
+                children = cell(1, s);
+                for ii = 1:s
+                    children{ii} = MexximpSceneTests.randomNode(s);
+                    children{ii}.children = [children{2:ii}];
+                end
+                scene.rootNode = MexximpSceneTests.randomNode(s);
+                scene.rootNode.children = [children{:}];
+                
+                % all nodes, depth first
+                flatScene = mexximpTest('scene', scene, options);
+                nNodes = MexximpSceneTests.countNodes(scene.rootNode);
+                flatNodes = flatScene.rootNode;
+                testCase.assertNumElements(flatNodes.names, nNodes);
+                testCase.assertEqual(flatNodes.names{1}, scene.rootNode.name);
+                testCase.assertEqual(flatNodes.names{2}, scene.rootNode.children(1).name);
+                testCase.assertEqual(flatNodes.parents(1), int32(-1));
+                testCase.assertTrue(all(flatNodes.parents(2:end) < int32(1:nNodes-1)));
+                testCase.assertSize(flatNodes.transformations, [4 4 nNodes]);
+                testCase.assertEqual(flatNodes.meshIndices(1:s), scene.rootNode.meshIndices);
+                
+                % flat nodes convert back to nested nodes
+                scenePrime = mexximpTest('scene', flatScene);
+                testCase.assertEqual(scenePrime, scene, ...
+                    'AbsTol', testCase.floatTolerance);
+            end
+        end
+        
+        function testCombineScenes(testCase)
+            scene = testCase.emptyScene;
+            scene.materials = struct('properties', struct( ...
+                'key', 'texture', ...
+                'dataType', 'string', ...
+                'data', {'*0', 'plain.png'}, ...
+                'textureSemantic', 'diffuse', ...
+                'textureIndex', 0));
+            scene.meshes = struct( ...
+                'name', {'a', 'b'}, ...
+                'materialIndex', {0, 0}, ...
+                'vertices', rand(3, 4));
+            scene.embeddedTextures = struct('image', randi(255, 1, 4, 'uint8'), 'format', 'png');
+            grandchild = MexximpSceneTests.randomNode(2);
+            grandchild.meshIndices = uint32(1);
+            scene.rootNode = MexximpSceneTests.randomNode(2);
+            scene.rootNode.children = MexximpSceneTests.randomNode(2);
+            scene.rootNode.children.meshIndices = uint32(0);
+            scene.rootNode.children.children = grandchild;
+            
+            % outer scene plus two copies, each element copied once
+            transforms = rand(4, 4, 2);
+            combined = mexximpCombine(scene, {scene, scene}, transforms, {'one_', 'two_'});
+            testCase.assertNumElements(combined.materials, 3);
+            testCase.assertNumElements(combined.meshes, 6);
+            testCase.assertNumElements(combined.embeddedTextures, 3);
+            testCase.assertNumElements(combined.rootNode.children, 3);
+            testCase.assertEqual(combined.rootNode.transformation, scene.rootNode.transformation);
+            
+            testCase.assertEqual({combined.meshes.name}, {'a', 'b', 'one_a', 'one_b', 'two_a', 'two_b'});
+            testCase.assertEqual([combined.meshes.materialIndex], [0 0 1 1 2 2]);
+            testCase.assertEqual({combined.materials(3).properties.data}, {'*2', 'plain.png'});
+            testCase.assertEqual(combined.meshes(5).vertices, scene.meshes(1).vertices);
+            
+            inserted = combined.rootNode.children(3);
+            testCase.assertEqual(inserted.name, ['two_' scene.rootNode.children.name]);
+            testCase.assertEqual(inserted.meshIndices, uint32(4));
+            testCase.assertEqual(inserted.children.meshIndices, uint32(5));
+            testCase.assertEqual(inserted.children.name, grandchild.name);
+            testCase.assertEqual(inserted.transformation, ...
+                transforms(:,:,2) * scene.rootNode.children.transformation, ...
+                'AbsTol', testCase.floatTolerance);
+            
+            % the outer scene is unchanged
+            testCase.assertEqual(combined.rootNode.children(1), scene.rootNode.children);
+        end
+
         function testCompressedTextureRoundTrip(testCase)
             scene = testCase.emptyScene;
             for s = testCase.itemSize
@@ -214,6 +429,13 @@ classdef MexximpSceneTests < matlab.unittest.TestCase
             end
         end
         
+        function nNodes = countNodes(node)
+            nNodes = 1;
+            for ii = 1:numel(node.children)
+                nNodes = nNodes + MexximpSceneTests.countNodes(node.children(ii));
+            end
+        end
+        
         function node = randomNode(nElements)
             node = struct( ...
                 'name', MexximpSceneTests.randomString(nElements), ...
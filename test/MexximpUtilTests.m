@@ -16,6 +16,14 @@ classdef MexximpUtilTests < matlab.unittest.TestCase
             end
         end
         
+        function testSingleXyzRoundTrips(testCase)
+            for ii = 1:numel(testCase.itemSize)
+                vectors = rand(3, testCase.itemSize(ii), 'single');
+                vectorsPrime = mexximpTest('xyz', vectors);
+                testCase.assertEqual(vectorsPrime, double(vectors));
+            end
+        end
+        
         function testStringRoundTrips(testCase)
             alphabet = '0':'z';
             for ii = 1:numel(testCase.itemSize)
@@ -43,6 +51,14 @@ classdef MexximpUtilTests < matlab.unittest.TestCase
             end
         end
         
+        function testSingleRgbaRoundTrips(testCase)
+            for ii = 1:numel(testCase.itemSize)
+                rgbas = rand(4, testCase.itemSize(ii), 'single');
+                rgbasPrime = mexximpTest('rgba', rgbas);
+                testCase.assertEqual(rgbasPrime, double(rgbas));
+            end
+        end
+        
         function testTexelRoundTrips(testCase)
             for ii = 1:numel(testCase.itemSize)
                 texels = randi(255, [4, testCase.itemSize(ii)], 'uint8');
@@ -20,7 +20,7 @@ function rootNode = mexximpFlattenNodes(scene)
 % Returns new rootNode struct, which is equivalent to the given
 % scene.rootNode, but with all its descendents "flattened out".
 %
-% See also mexximpVisitNodes
+% See also mexximpNodes mexximpVisitNodes
 %
 % rootNode = mexximpFlattenNodes(scene)
 %
@@ -31,26 +31,7 @@ parser.addRequired('scene', @isstruct);
 parser.parse(scene);
 scene = parser.Results.scene;
 
-%% Apply a visitFunction to each scene node.
-children = mexximpVisitNodes(scene, @flattenChildren);
-
-%% Build a new root node equivalent to the original.
-rootNode = scene.rootNode;
-
+%% Walk the node hierarchy once, natively.
+% each child gets its "inherited", combined transformation
 % root transform was already applied to each node
-rootNode.transformation = mexximpIdentity();
-
-% first "child" is really the root itself
-rootNode.children = children(2:end);
-
-%% Node visitFunction to merge child nodes into a flat array.
-function children = flattenChildren(scene, node, childResults, workingTransformation)
-
-% apply "inherited", combined transformation directly to this node 
-node.transformation = workingTransformation;
-
-% children will become peers, so don't include them as children
-node.children = [];
-
-% suck up child results and combine
-children = [node, childResults{:}];
+rootNode = mexximpNodes('flatten', scene);
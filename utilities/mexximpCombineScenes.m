@@ -1,30 +1,40 @@
 function [combined, outerElements, innerElements] = mexximpCombineScenes(outer, inner, varargin)
-%% Combine two scenes by copying materials, meshes, and nodes.
+%% Combine scenes by copying materials, meshes, textures, and nodes.
 %
-% combined = mexximpCombineScenes(outer, inner) combines the two given
-% scenes by copying all materials, meshes, and nodes from the given innder
-% scene into the given outer scene.  Updates material and mesh indeices
-% accordingly.
+% combined = mexximpCombineScenes(outer, inner) combines the given scenes
+% by copying all materials, meshes, embedded textures, and nodes from the
+% given inner scene into the given outer scene.  Updates material, mesh,
+% and embedded texture indices accordingly, including mesh indices of
+% nested nodes.  inner may also be a struct array or cell array of several
+% scenes, which are all combined natively in one pass.
 %
 % mexximpCombineScenes( ... 'cleanupTransform', cleanupTransform) specify a
 % transformation matrix to apply to the inner scene, before combining.
 % This can help resolve mismatches in scene scaling, etc.  The default is
 % to transform the inner scene so that its bounding box is centered at the
-% origin, and its longest dimension is 1.
+% origin, and its longest dimension is 1.  For several inner scenes, this
+% may be 4x4xN, one transform per inner scene.
 %
 % mexximpCombineScenes( ... 'insertTransform', insertTransform) specify a
 % transformation matrix to apply to the innner scene, after the
 % cleanupTransform.  This is a good way to place the inner scene where it
 % belongs in the outer scene.  The default is to place the inner scene at
-% the center of the outer scene's bounding box.
+% the center of the outer scene's bounding box.  For several inner scenes,
+% this may be 4x4xN, one transform per inner scene.
+%
+% The combined cleanup and insert transforms premultiply the transformation
+% of each top-level node from the inner scene.
 %
 % mexximpCombineScenes( ... 'insertPrefix', insertPrefix) specify a prefix to
-% add to each node name from the inner scene.  The default is '', don't add
-% any prefix.
+% add to each mesh name and top-level node name from the inner scene.  For
+% several inner scenes, this may be a cell array with one prefix per inner
+% scene.  The default is '', don't add any prefix.
 %
 % Returns a new, combined scene struct.  Also returns an array of scene
 % elements that came from the outer scene, and an array of elements that
-% came from the inner scene.
+% came from the inner scene or scenes.
+%
+% See also mexximpCombine
 %
 % [combined, outerElements, innerElements] = mexximpCombineScenes(outer, inner, varargin)
 %
@@ -32,10 +42,10 @@ function [combined, outerElements, innerElements] = mexximpCombineScenes(outer,
 
 parser = inputParser();
 parser.addRequired('outer', @isstruct);
-parser.addRequired('inner', @isstruct);
+parser.addRequired('inner', @(s) isstruct(s) || iscell(s));
 parser.addParameter('cleanupTransform', [], @isnumeric);
 parser.addParameter('insertTransform', [], @isnumeric);
-parser.addParameter('insertPrefix', '', @ischar);
+parser.addParameter('insertPrefix', '', @(s) ischar(s) || iscellstr(s));
 parser.parse(outer, inner, varargin{:});
 outer = parser.Results.outer;
 inner = parser.Results.inner;
@@ -43,64 +53,46 @@ cleanupTransform = parser.Results.cleanupTransform;
 insertTransform = parser.Results.insertTransform;
 insertPrefix = parser.Results.insertPrefix;
 
-combined = outer;
-
-%% Choose transforms to reconcile the scenes.
-[innerBox, innerMidpoint] = mexximpSceneBox(inner);
-if isempty(cleanupTransform)
-    innerSize = max(abs(innerBox(:,1) - innerBox(:,2)));
-    innerScale = 1 / innerSize;
-    cleanupTransform = mexximpTranslate(-innerMidpoint) * mexximpScale(innerScale * [1 1 1]);
+if isstruct(inner)
+    inner = num2cell(inner);
 end
+nInner = numel(inner);
 
-[outerBox, outerMidpoint] = mexximpSceneBox(outer);
-if isempty(insertTransform)
-    insertTransform = mexximpTranslate(outerMidpoint);
+%% Choose transforms to reconcile the scenes.
+importTransforms = zeros(4, 4, nInner);
+[~, outerMidpoint] = mexximpSceneBox(outer);
+for ii = 1:nInner
+    if isempty(cleanupTransform)
+        [innerBox, innerMidpoint] = mexximpSceneBox(inner{ii});
+        if isempty(innerBox)
+            innerCleanup = eye(4);
+        else
+            innerSize = max(abs(innerBox(:,1) - innerBox(:,2)));
+            innerScale = 1 / innerSize;
+            innerCleanup = mexximpTranslate(-innerMidpoint) * mexximpScale(innerScale * [1 1 1]);
+        end
+    else
+        innerCleanup = cleanupTransform(:, :, min(ii, size(cleanupTransform, 3)));
+    end
+    
+    if isempty(insertTransform)
+        innerInsert = mexximpTranslate(outerMidpoint);
+    else
+        innerInsert = insertTransform(:, :, min(ii, size(insertTransform, 3)));
+    end
+    
+    importTransforms(:, :, ii) = innerCleanup * innerInsert;
 end
 
-importTransform = cleanupTransform * insertTransform;
+%% Copy materials, meshes, textures, and nodes natively, with offsets.
+combined = mexximpCombine(outer, inner, importTransforms, insertPrefix);
 
-%% Copy materials.
+%% Report where elements in the combined scene came from.
 nOuterMaterials = numel(outer.materials);
-combined.materials = cat(2, outer.materials, inner.materials);
-
-%% Copy Meshes with material offset.
-%  but adding the prefix.
 nOuterMeshes = numel(outer.meshes);
-nInnerMeshes = numel(inner.meshes);
-
-
-for mm = 1:nInnerMeshes
-    inner.meshes(mm).name = [insertPrefix inner.meshes(mm).name];
-    if ~isempty(inner.meshes(mm).materialIndex)
-        inner.meshes(mm).materialIndex = ...
-            inner.meshes(mm).materialIndex + nOuterMaterials;
-    end
-end
-
-combined.meshes = cat(2, outer.meshes, inner.meshes);
-
-%% Copy Nodes with mesh offset and transformation.
+nOuterTextures = numel(outer.embeddedTextures);
 nOuterNodes = numel(outer.rootNode.children);
-nInnerNodes = numel(inner.rootNode.children);
-
 
-% Shouldn't this be done recursively?
-% what if rootNode.children.children is not empty?
-for mm = 1:nInnerNodes
-    if ~isempty(inner.rootNode.children(mm).meshIndices)
-        inner.rootNode.children(mm).name = ...
-            [insertPrefix inner.rootNode.children(mm).name];
-        inner.rootNode.children(mm).meshIndices = ...
-            inner.rootNode.children(mm).meshIndices + nOuterMeshes;
-        inner.rootNode.children(mm).transformation = ...
-            importTransform * inner.rootNode.children(mm).transformation;
-    end
-end
-
-combined.rootNode.children = cat(2, outer.rootNode.children, inner.rootNode.children);
-
-%% Report where elements in the combined scene came from.
 combinedElements = mexximpSceneElements(combined);
 nElements = numel(combinedElements);
 isOuterElement = true(1, nElements);
@@ -108,6 +100,7 @@ for ee = 1:nElements
     % all elements are outer elements, except:
     %   appended materials
     %   appended meshes
+    %   appended embedded textures
     %   appended nodes
     element = combinedElements(ee);
     elementIndex = element.path{end};
@@ -116,10 +109,11 @@ for ee = 1:nElements
             isOuterElement(ee) = elementIndex <= nOuterMaterials;
         case 'meshes'
             isOuterElement(ee) = elementIndex <= nOuterMeshes;
+        case 'embeddedTextures'
+            isOuterElement(ee) = elementIndex <= nOuterTextures;
         case 'nodes'
-            isOuterElement(ee) = isnumeric(elementIndex) && elementIndex <= nOuterNodes;
+            isOuterElement(ee) = numel(element.path) < 3 || element.path{3} <= nOuterNodes;
     end
 end
 outerElements = combinedElements(isOuterElement);
 innerElements = combinedElements(~isOuterElement);
-
@@ -14,7 +14,7 @@ function ax = mexximpSceneScatter(scene, varargin)
 %
 % Returns the axes used for plotting.
 %
-% See also mexximpVisitNodes
+% See also mexximpNodes
 %
 % ax = mexximpSceneScatter(scene, varargin)
 %
@@ -35,7 +35,7 @@ if isempty(ax) || ~isa(ax, 'matlab.graphics.axis.Axes');
     ax = axes('Parent', fig);
 end
 
-%% Apply a visitFunction to each scene node.
+%% Visit each scene node.
 if isempty(scene.cameras)
     cameraNames = {};
 else
@@ -48,10 +48,16 @@ else
     lightNames = {scene.lights.name};
 end
 
-mexximpVisitNodes(scene, @scatterMeshes, ax, ignoreNodes, cameraNames, lightNames);
+% flat nodes and world transforms come out in the same, depth-first order
+flatRoot = mexximpNodes('flatten', scene);
+worldTransforms = mexximpNodes('world', scene);
+nodes = [flatRoot, flatRoot.children];
+for nn = 1:numel(nodes)
+    scatterMeshes(scene, nodes(nn), worldTransforms(:,:,nn), ax, ignoreNodes, cameraNames, lightNames);
+end
 
-%% Node visitFunction to plot mesh into given axes.
-function ax = scatterMeshes(scene, node, ~, workingTransformation, ax, ignoreNodes, cameraNames, lightNames)
+%% Plot meshes for one node into given axes.
+function ax = scatterMeshes(scene, node, workingTransformation, ax, ignoreNodes, cameraNames, lightNames)
 
 % ignore this node?
 if any(strcmp(node.name, ignoreNodes))
@@ -49,6 +49,11 @@ function mexximpWriteTriangleMeshPly(outputFile, xyz, faces, varargin)
 % not human-readable but should enjoy higher floating point precision,
 % smaller file size, and faster writing and loading times.
 %
+% The 'binary_little_endian' format is written natively by mexximpWritePly,
+% which streams single or double data to the file in large chunks,
+% without making interleaved copies in Matlab.  This is the fastest way to
+% write large meshes.
+%
 % Here's a full example with the same square geometry as above, plus
 % normals facing up the z-axis, simple UV mapping, and colorful corners:
 %   xyz = [0 0 0; 0 1 0; 1 1 0; 1 0 0]';
@@ -109,6 +114,18 @@ uvs = parser.Results.uvs;
 colors = parser.Results.colors;
 format = parser.Results.format;
 
+%% Stream large binary meshes natively.
+if ischar(outputFile) && strcmp(format, 'binary_little_endian') ...
+        && (isfloat(xyz) && isreal(xyz)) ...
+        && all(cellfun(@(a) isfloat(a) && isreal(a), {normals, uvs, colors}))
+    status = mexximpWritePly(outputFile, xyz, faces, normals, uvs, colors);
+    if 0 ~= status
+        error('mexximpWriteTriangleMeshPly:writeFailed', ...
+            'Could not write PLY file <%s>.', outputFile);
+    end
+    return;
+end
+
 %% Try to close the file even if there's an error.
 fid = [];
 try